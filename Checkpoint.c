@@ -0,0 +1,367 @@
+/*
+ * Checkpoint.c -- periodic checkpoints and restart of a simulation
+ *
+ * Layout: a CheckpointHeader, the lines in lines array order, the retired
+ * lines in retiredLines order, then the dynamic and the static quadtree.
+ * A tree is written in preorder, each node as {hasChildren, numberOfLines,
+ * line indices in list order} followed by its nw, ne, sw and se children.
+ * Node bounds aren't stored; they are recomputed the way divideNode
+ * computes them.
+ */
+
+#include "./Checkpoint.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cilk/cilk.h>
+
+static const char CHECKPOINT_MAGIC[8] = {
+  'L', 'I', 'N', 'E', 'C', 'K', 'P', '\0'
+};
+#define CHECKPOINT_VERSION 5
+
+typedef struct {
+  char magic[8];
+  uint32_t version;
+  uint32_t lineSize;  // sizeof(Line) of the build that wrote the checkpoint
+  uint32_t numOfLines;
+  uint32_t numOfRetiredLines;
+  uint32_t nextId;
+  uint32_t frame;
+  uint32_t quadtreeFrame;
+  uint32_t numLineWallCollisions;
+  uint32_t numLineLineCollisions;
+  uint32_t numActiveLines;
+  uint32_t maxLinesPerNode;
+  double timeStep;
+  uint64_t numNarrowPhaseTests;
+  uint64_t numNarrowPhaseSkips;
+  uint64_t numBoxRejects;
+  uint64_t numEvents;
+  uint64_t treeSize;  // int32_t words in the dynamic tree
+  uint64_t staticTreeSize;  // int32_t words in the static tree
+} CheckpointHeader;
+
+// A growable preorder encoding of a quadtree.
+typedef struct {
+  int32_t *words;
+  uint64_t size;
+  uint64_t capacity;
+} TreeEncoding;
+
+// Everything the writer thread needs; owned by the writer once started.
+typedef struct {
+  CheckpointHeader header;
+  Line *lines;
+  Line *retiredLines;
+  TreeEncoding tree;
+  TreeEncoding staticTree;
+  CheckpointWriter *writer;
+} Snapshot;
+
+struct CheckpointWriter {
+  char *path;
+  pthread_t thread;
+  bool running;
+  bool failed;  // set by the writer thread, read after joining it
+};
+
+static void pushWord(TreeEncoding *encoding, int32_t word) {
+  if (encoding->size == encoding->capacity) {
+    encoding->capacity = encoding->capacity ? 2 * encoding->capacity : 1024;
+    encoding->words = realloc(encoding->words,
+                              encoding->capacity * sizeof(int32_t));
+  }
+  encoding->words[encoding->size++] = word;
+}
+
+static void encodeNode(TreeEncoding *encoding, Node *node) {
+  int32_t numberOfLines = 0;
+  for (LineNode *lineNode = node->lines; lineNode != NULL;
+       lineNode = lineNode->next) {
+    numberOfLines++;
+  }
+  // checkpoints are taken between frames, when every buffer is attached
+  assert(node->buffer == NULL);
+  pushWord(encoding, node->nw != NULL);
+  pushWord(encoding, numberOfLines);
+  for (LineNode *lineNode = node->lines; lineNode != NULL;
+       lineNode = lineNode->next) {
+    pushWord(encoding, lineNode->line->index);
+  }
+  if (node->nw != NULL) {
+    encodeNode(encoding, node->nw);
+    encodeNode(encoding, node->ne);
+    encodeNode(encoding, node->sw);
+    encodeNode(encoding, node->se);
+  }
+}
+
+static bool writeSnapshot(Snapshot *snapshot, FILE *fout) {
+  const unsigned int numOfLines = snapshot->header.numOfLines;
+  const unsigned int numOfRetiredLines = snapshot->header.numOfRetiredLines;
+  if (fwrite(&snapshot->header, sizeof(CheckpointHeader), 1, fout) != 1
+      || fwrite(snapshot->lines, sizeof(Line), numOfLines, fout)
+         != numOfLines
+      || fwrite(snapshot->retiredLines, sizeof(Line), numOfRetiredLines,
+                fout) != numOfRetiredLines) {
+    return false;
+  }
+  return fwrite(snapshot->tree.words, sizeof(int32_t), snapshot->tree.size,
+                fout) == snapshot->tree.size
+      && fwrite(snapshot->staticTree.words, sizeof(int32_t),
+                snapshot->staticTree.size, fout) == snapshot->staticTree.size;
+}
+
+// Writes to a temporary file and renames it over path, so a crash while
+// writing never destroys the previous checkpoint.
+static void * writerMain(void *arg) {
+  Snapshot *snapshot = arg;
+  const char *path = snapshot->writer->path;
+  size_t pathLength = strlen(path);
+  char *tempPath = malloc(pathLength + sizeof(".tmp"));
+  memcpy(tempPath, path, pathLength);
+  memcpy(tempPath + pathLength, ".tmp", sizeof(".tmp"));
+
+  FILE *fout = fopen(tempPath, "wb");
+  bool ok = fout != NULL && writeSnapshot(snapshot, fout);
+  if (fout != NULL && fclose(fout) != 0) {
+    ok = false;
+  }
+  if (ok && rename(tempPath, path) != 0) {
+    ok = false;
+  }
+  if (!ok) {
+    perror(tempPath);
+    snapshot->writer->failed = true;
+  }
+
+  free(tempPath);
+  free(snapshot->lines);
+  free(snapshot->retiredLines);
+  free(snapshot->tree.words);
+  free(snapshot->staticTree.words);
+  free(snapshot);
+  return NULL;
+}
+
+CheckpointWriter* Checkpoint_newWriter(const char *path) {
+  CheckpointWriter *writer = calloc(1, sizeof(CheckpointWriter));
+  writer->path = strdup(path);
+  return writer;
+}
+
+static void waitForWriter(CheckpointWriter *writer) {
+  if (writer->running) {
+    pthread_join(writer->thread, NULL);
+    writer->running = false;
+  }
+}
+
+void Checkpoint_save(CheckpointWriter *writer, LineDemo *lineDemo) {
+  CollisionWorld *collisionWorld = lineDemo->collisionWorld;
+  const unsigned int numOfLines = collisionWorld->numOfLines;
+  const unsigned int numOfRetiredLines = collisionWorld->numOfRetiredLines;
+
+  // the previous checkpoint must be on disk before its file is replaced
+  waitForWriter(writer);
+
+  Snapshot *snapshot = calloc(1, sizeof(Snapshot));
+  snapshot->writer = writer;
+  CheckpointHeader *header = &snapshot->header;
+  memcpy(header->magic, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+  header->version = CHECKPOINT_VERSION;
+  header->lineSize = sizeof(Line);
+  header->numOfLines = numOfLines;
+  header->numOfRetiredLines = numOfRetiredLines;
+  header->nextId = collisionWorld->nextId;
+  header->frame = lineDemo->count;
+  header->quadtreeFrame = collisionWorld->frame;
+  header->numLineWallCollisions = collisionWorld->numLineWallCollisions;
+  header->numLineLineCollisions = collisionWorld->numLineLineCollisions;
+  header->numActiveLines = collisionWorld->numActiveLines;
+  header->maxLinesPerNode = collisionWorld->maxLinesPerNode;
+  header->timeStep = collisionWorld->timeStep;
+  header->numNarrowPhaseTests = collisionWorld->numNarrowPhaseTests;
+  header->numNarrowPhaseSkips = collisionWorld->numNarrowPhaseSkips;
+  header->numBoxRejects = collisionWorld->numBoxRejects;
+  header->numEvents = collisionWorld->numEvents;
+
+  // The simulation only stalls to copy the lines and translate the tree's
+  // pointers to indices, which must be done before lines move.  Pair
+  // certificates name lines by id, so they are copied as they are.
+  snapshot->lines = malloc(numOfLines * sizeof(Line));
+  cilk_for (unsigned int i = 0; i < numOfLines; i++) {
+    snapshot->lines[i] = *collisionWorld->lines[i];
+  }
+  snapshot->retiredLines = malloc(numOfRetiredLines * sizeof(Line));
+  for (unsigned int i = 0; i < numOfRetiredLines; i++) {
+    snapshot->retiredLines[i] = *collisionWorld->retiredLines[i];
+  }
+  encodeNode(&snapshot->tree, collisionWorld->quadtree);
+  if (collisionWorld->staticQuadtree != NULL) {
+    encodeNode(&snapshot->staticTree, collisionWorld->staticQuadtree);
+  }
+  header->treeSize = snapshot->tree.size;
+  header->staticTreeSize = snapshot->staticTree.size;
+
+  if (pthread_create(&writer->thread, NULL, writerMain, snapshot) != 0) {
+    // no thread to spare; write in the foreground instead
+    writerMain(snapshot);
+    return;
+  }
+  writer->running = true;
+}
+
+bool Checkpoint_finish(CheckpointWriter *writer) {
+  waitForWriter(writer);
+  const bool ok = !writer->failed;
+  free(writer->path);
+  free(writer);
+  return ok;
+}
+
+// Reads one node and its subtree from [*cursor, end).  Returns NULL if the
+// encoding is malformed.
+static Node * decodeNode(const int32_t **cursor, const int32_t *end,
+                         double xMin, double xMax, double yMin, double yMax,
+                         Node *parent, Line *lineData, uint32_t numOfLines) {
+  if (end - *cursor < 2) {
+    return NULL;
+  }
+  const bool hasChildren = (*cursor)[0] != 0;
+  const int32_t numberOfLines = (*cursor)[1];
+  *cursor += 2;
+  if (numberOfLines < 0 || end - *cursor < numberOfLines) {
+    return NULL;
+  }
+
+  Node *node = create_node(xMin, xMax, yMin, yMax);
+  node->parent = parent;
+  // prepend from the tail so the list keeps its saved order
+  for (int32_t i = numberOfLines - 1; i >= 0; i--) {
+    const int32_t index = (*cursor)[i];
+    if (index < 0 || (uint32_t) index >= numOfLines) {
+      freeNode(node);
+      return NULL;
+    }
+    addQuadtreeLineNode(node, createLineNode(node->lines, &lineData[index]));
+  }
+  *cursor += numberOfLines;
+
+  if (hasChildren) {
+    double xMid = (xMin + xMax) / 2.0;
+    double yMid = (yMin + yMax) / 2.0;
+    node->nw = decodeNode(cursor, end, xMin, xMid, yMid, yMax, node,
+                          lineData, numOfLines);
+    node->ne = decodeNode(cursor, end, xMid, xMax, yMid, yMax, node,
+                          lineData, numOfLines);
+    node->sw = decodeNode(cursor, end, xMin, xMid, yMin, yMid, node,
+                          lineData, numOfLines);
+    node->se = decodeNode(cursor, end, xMid, xMax, yMin, yMid, node,
+                          lineData, numOfLines);
+    if (node->nw == NULL || node->ne == NULL || node->sw == NULL
+        || node->se == NULL) {
+      freeNode(node);
+      return NULL;
+    }
+  }
+  return node;
+}
+
+static Node * decodeTree(const int32_t *words, uint64_t size,
+                         Line *lineData, uint32_t numOfLines) {
+  const int32_t *cursor = words;
+  Node *root = decodeNode(&cursor, words + size, BOX_XMIN, BOX_XMAX,
+                          BOX_YMIN, BOX_YMAX, NULL, lineData, numOfLines);
+  if (root != NULL && cursor != words + size) {
+    freeNode(root);
+    return NULL;
+  }
+  return root;
+}
+
+static bool readArray(void *data, size_t size, size_t count, FILE *fin) {
+  return fread(data, size, count, fin) == count;
+}
+
+bool Checkpoint_restore(const char *path, LineDemo *lineDemo) {
+  FILE *fin = fopen(path, "rb");
+  if (fin == NULL) {
+    perror(path);
+    return false;
+  }
+
+  CheckpointHeader header;
+  if (!readArray(&header, sizeof(header), 1, fin)
+      || memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC)) != 0
+      || header.version != CHECKPOINT_VERSION
+      || header.lineSize != sizeof(Line)
+      || header.numOfLines == 0) {
+    fprintf(stderr, "%s: not a version %d checkpoint from this build\n", path,
+            CHECKPOINT_VERSION);
+    fclose(fin);
+    return false;
+  }
+
+  const uint32_t numOfLines = header.numOfLines;
+  CollisionWorld *collisionWorld = CollisionWorld_new(numOfLines);
+  Line *lines = CollisionWorld_reserveLines(collisionWorld, numOfLines);
+  Line *retiredLines = malloc(header.numOfRetiredLines * sizeof(Line));
+  int32_t *tree = malloc(header.treeSize * sizeof(int32_t));
+  int32_t *staticTree = malloc(header.staticTreeSize * sizeof(int32_t));
+  bool ok = readArray(lines, sizeof(Line), numOfLines, fin)
+      && readArray(retiredLines, sizeof(Line), header.numOfRetiredLines, fin)
+      && readArray(tree, sizeof(int32_t), header.treeSize, fin)
+      && readArray(staticTree, sizeof(int32_t), header.staticTreeSize, fin);
+  fclose(fin);
+  for (uint32_t i = 0; ok && i < header.numOfRetiredLines; i++) {
+    ok = retiredLines[i].kind == RETIRED_LINE;
+  }
+
+  Node *quadtree = NULL;
+  if (ok) {
+    CollisionWorld_commitLines(collisionWorld, lines, numOfLines);
+    CollisionWorld_addRetiredLines(collisionWorld, retiredLines,
+                                   header.numOfRetiredLines);
+    quadtree = decodeTree(tree, header.treeSize, lines, numOfLines);
+    if (header.staticTreeSize > 0) {
+      collisionWorld->staticQuadtree = decodeTree(
+          staticTree, header.staticTreeSize, lines, numOfLines);
+      ok = collisionWorld->staticQuadtree != NULL;
+    }
+    ok = ok && quadtree != NULL;
+  }
+  free(retiredLines);
+  free(tree);
+  free(staticTree);
+
+  if (!ok) {
+    fprintf(stderr, "%s: truncated or corrupt checkpoint\n", path);
+    freeNode(quadtree);
+    CollisionWorld_delete(collisionWorld);
+    return false;
+  }
+
+  // the lines' future points were saved for this time step
+  collisionWorld->timeStep = header.timeStep;
+  collisionWorld->maxLinesPerNode = header.maxLinesPerNode;
+  collisionWorld->quadtree = quadtree;
+  collisionWorld->frame = header.quadtreeFrame;
+  collisionWorld->nextId = header.nextId;
+
+  collisionWorld->numLineWallCollisions = header.numLineWallCollisions;
+  collisionWorld->numLineLineCollisions = header.numLineLineCollisions;
+  collisionWorld->numActiveLines = header.numActiveLines;
+  collisionWorld->numNarrowPhaseTests = header.numNarrowPhaseTests;
+  collisionWorld->numNarrowPhaseSkips = header.numNarrowPhaseSkips;
+  collisionWorld->numBoxRejects = header.numBoxRejects;
+  collisionWorld->numEvents = header.numEvents;
+  lineDemo->collisionWorld = collisionWorld;
+  lineDemo->count = header.frame;
+  return true;
+}
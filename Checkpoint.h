@@ -0,0 +1,41 @@
+/*
+ * Checkpoint.h -- periodic checkpoints and restart of a simulation
+ *
+ * A checkpoint holds every line (positions, velocities, ids, sleep state
+ * and certificates), the storage and ids of removed lines awaiting reuse,
+ * the next new id, the collision counters, the frame count, the time
+ * step and node capacity, and the layout of both quadtrees, so a restarted
+ * run neither rebuilds the tree nor replays frames and produces
+ * bit-identical results.  Checkpoints are raw dumps of Line and only load
+ * into the same build.
+ */
+
+#ifndef CHECKPOINT_H_
+#define CHECKPOINT_H_
+
+#include <stdbool.h>
+
+#include "./LineDemo.h"
+#include "./Quadtree.h"
+
+// Writes one world's checkpoints to one path, each on a background thread.
+// Writers share nothing, so several worlds can checkpoint at once.
+typedef struct CheckpointWriter CheckpointWriter;
+
+CheckpointWriter* Checkpoint_newWriter(const char *path);
+
+// Snapshot the simulation after lineDemo->count frames, quadtrees included,
+// and write it to the writer's path on a background thread.  Waits for the
+// writer's previous checkpoint, if it is still being written.
+void Checkpoint_save(CheckpointWriter *writer, LineDemo *lineDemo);
+
+// Wait until the writer's last checkpoint is on disk, and free the writer.
+// Returns false if writing any of its checkpoints failed.
+bool Checkpoint_finish(CheckpointWriter *writer);
+
+// Restore lineDemo's CollisionWorld, with its quadtrees, and frame count
+// from the checkpoint at path.  Returns false, after printing why, if the
+// checkpoint can't be loaded.
+bool Checkpoint_restore(const char *path, LineDemo *lineDemo);
+
+#endif  // CHECKPOINT_H_
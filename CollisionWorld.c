@@ -27,20 +27,42 @@
 #include <math.h>
 #include <assert.h>
 #include <stdio.h>
+#include <string.h>
+#include <cilk/cilk.h>
+#include <cilk/reducer_opadd.h>
 
 #include "./IntersectionDetection.h"
 #include "./IntersectionEventList.h"
 #include "./Line.h"
+#include "./MemoryStats.h"
+#include "./PublishedFrames.h"
 #include "./Quadtree.h"
+#include "./Tracer.h"
 
 void setStartAndMid(IntersectionEventNode * headNode, IntersectionEventNode ** start, IntersectionEventNode ** mid);
 IntersectionEventNode * combineSortedLists(IntersectionEventNode * start, IntersectionEventNode * mid);
-void mergeSort(IntersectionEventNode ** headNode);
 
+// Number of lines advanced by one task of the position update.
+#define LINE_UPDATE_BLOCK 512
+
+
+// Appends a chunk with room for at least count lines.
+static LineChunk* addLineChunk(CollisionWorld* collisionWorld,
+                               const unsigned int count) {
+  if (collisionWorld->numOfChunks == collisionWorld->maxChunks) {
+    collisionWorld->maxChunks *= 2;
+    collisionWorld->chunks = realloc(collisionWorld->chunks,
+        collisionWorld->maxChunks * sizeof(LineChunk));
+  }
+  LineChunk* chunk = &collisionWorld->chunks[collisionWorld->numOfChunks++];
+  chunk->capacity = count > LINE_CHUNK_LINES ? count : LINE_CHUNK_LINES;
+  chunk->lines = malloc(chunk->capacity * sizeof(Line));
+  chunk->used = 0;
+  return chunk;
+}
 
 CollisionWorld* CollisionWorld_new(const unsigned int capacity) {
   assert(capacity > 0);
-  __cilkrts_set_param("nworkers", "1"); 
   CollisionWorld* collisionWorld = malloc(sizeof(CollisionWorld));
   if (collisionWorld == NULL) {
     return NULL;
@@ -48,17 +70,62 @@ CollisionWorld* CollisionWorld_new(const unsigned int capacity) {
 
   collisionWorld->numLineWallCollisions = 0;
   collisionWorld->numLineLineCollisions = 0;
-  collisionWorld->timeStep = 0.5;
+  collisionWorld->numNarrowPhaseTests = 0;
+  collisionWorld->numNarrowPhaseSkips = 0;
+  collisionWorld->numBoxRejects = 0;
+  collisionWorld->numEvents = 0;
+  collisionWorld->timeStep = DEFAULT_TIME_STEP;
+  collisionWorld->maxLinesPerNode = DEFAULT_MAX_LINES_PER_NODE;
+  collisionWorld->chunks = malloc(sizeof(LineChunk));
+  collisionWorld->numOfChunks = 0;
+  collisionWorld->maxChunks = 1;
+  addLineChunk(collisionWorld, capacity);
   collisionWorld->lines = malloc(capacity * sizeof(Line*));
   collisionWorld->numOfLines = 0;
+  collisionWorld->capacity = capacity;
+  collisionWorld->retiredLines = NULL;
+  collisionWorld->numOfRetiredLines = 0;
+  collisionWorld->nextId = 0;
+  collisionWorld->lineSetPins = 0;
+  collisionWorld->staticLines = malloc(capacity * sizeof(Line*));
+  collisionWorld->numOfStaticLines = 0;
+  collisionWorld->staticCapacity = capacity;
+  collisionWorld->staticQuadtree = NULL;
+  collisionWorld->quadtree = NULL;
+  collisionWorld->frame = 0;
+  collisionWorld->publishedFrames = NULL;
+  collisionWorld->differential = NULL;
+  collisionWorld->numActiveLines = 0;
+
+  IntersectionEventListReducer events = CILK_C_INIT_REDUCER(
+      IntersectionEventList, IntersectionEventList_reduce,
+      IntersectionEventList_identity, IntersectionEventList_destroy,
+      IntersectionEventList_make());
+  collisionWorld->events = events;
+  CILK_C_REGISTER_REDUCER(collisionWorld->events);
+#ifdef PHASE_TIMING
+  PhaseTimers_init(&collisionWorld->phaseTimers);
+#endif
   return collisionWorld;
 }
 
 void CollisionWorld_delete(CollisionWorld* collisionWorld) {
-  for (int i = 0; i < collisionWorld->numOfLines; i++) {
-    free(collisionWorld->lines[i]);
+  CILK_C_UNREGISTER_REDUCER(collisionWorld->events);
+  IntersectionEventList_deleteNodes(&collisionWorld->events.value);
+  PublishedFrames_delete(collisionWorld->publishedFrames);
+  free(collisionWorld->differential);
+  freeNode(collisionWorld->quadtree);
+  freeNode(collisionWorld->staticQuadtree);
+  free(collisionWorld->staticLines);
+  for (unsigned int i = 0; i < collisionWorld->numOfChunks; i++) {
+    free(collisionWorld->chunks[i].lines);
   }
+  free(collisionWorld->chunks);
   free(collisionWorld->lines);
+  free(collisionWorld->retiredLines);
+#ifdef PHASE_TIMING
+  PhaseTimers_destroy(&collisionWorld->phaseTimers);
+#endif
   free(collisionWorld);
 }
 
@@ -66,9 +133,144 @@ unsigned int CollisionWorld_getNumOfLines(CollisionWorld* collisionWorld) {
   return collisionWorld->numOfLines;
 }
 
-void CollisionWorld_addLine(CollisionWorld* collisionWorld, Line *line) {
+// Adds a stored line to the lines array, and to the static lines if static.
+static void appendLine(CollisionWorld* collisionWorld, Line *line) {
+  if (collisionWorld->numOfLines == collisionWorld->capacity) {
+    collisionWorld->capacity *= 2;
+    collisionWorld->lines = realloc(collisionWorld->lines,
+        collisionWorld->capacity * sizeof(Line*));
+  }
+  line->index = collisionWorld->numOfLines;
   collisionWorld->lines[collisionWorld->numOfLines] = line;
   collisionWorld->numOfLines++;
+  if (line->id >= collisionWorld->nextId) {
+    collisionWorld->nextId = line->id + 1;
+  }
+  if (line->kind == STATIC_LINE) {
+    if (collisionWorld->numOfStaticLines == collisionWorld->staticCapacity) {
+      collisionWorld->staticCapacity *= 2;
+      collisionWorld->staticLines = realloc(collisionWorld->staticLines,
+          collisionWorld->staticCapacity * sizeof(Line*));
+    }
+    collisionWorld->staticLines[collisionWorld->numOfStaticLines] = line;
+    collisionWorld->numOfStaticLines++;
+  }
+}
+
+void CollisionWorld_setTimeStep(CollisionWorld* collisionWorld,
+                                double timeStep) {
+  assert(collisionWorld->quadtree == NULL);
+  collisionWorld->timeStep = timeStep;
+  cilk_for (unsigned int i = 0; i < collisionWorld->numOfLines; i++) {
+    updateLineFuturePoints(collisionWorld->lines[i], timeStep);
+  }
+}
+
+void CollisionWorld_buildQuadtrees(CollisionWorld* collisionWorld) {
+  collisionWorld->quadtree = bulkBuildRoot(collisionWorld);
+  collisionWorld->staticQuadtree = instantiateStaticIndex(collisionWorld);
+}
+
+void CollisionWorld_publishFrames(CollisionWorld* collisionWorld) {
+  assert(collisionWorld->publishedFrames == NULL);
+  collisionWorld->publishedFrames = PublishedFrames_new(collisionWorld);
+}
+
+void CollisionWorld_addLine(CollisionWorld* collisionWorld, const Line *line) {
+  Line *slot = CollisionWorld_reserveLines(collisionWorld, 1);
+  *slot = *line;
+  CollisionWorld_commitLines(collisionWorld, slot, 1);
+}
+
+Line* CollisionWorld_reserveLines(CollisionWorld* collisionWorld,
+                                  const unsigned int count) {
+  LineChunk *chunk = &collisionWorld->chunks[collisionWorld->numOfChunks - 1];
+  if (chunk->capacity - chunk->used < count) {
+    chunk = addLineChunk(collisionWorld, count);
+  }
+  return &chunk->lines[chunk->used];
+}
+
+void CollisionWorld_commitLines(CollisionWorld* collisionWorld, Line *first,
+                                const unsigned int count) {
+  LineChunk *chunk = &collisionWorld->chunks[collisionWorld->numOfChunks - 1];
+  assert(first == &chunk->lines[chunk->used]);
+  assert(count <= chunk->capacity - chunk->used);
+  chunk->used += count;
+  for (unsigned int i = 0; i < count; i++) {
+    appendLine(collisionWorld, &first[i]);
+  }
+}
+
+static void pushRetiredLine(CollisionWorld* collisionWorld, Line *line) {
+  if ((collisionWorld->numOfRetiredLines
+       & (collisionWorld->numOfRetiredLines - 1)) == 0) {
+    // grow at powers of two
+    unsigned int size = collisionWorld->numOfRetiredLines
+        ? 2 * collisionWorld->numOfRetiredLines : 1;
+    collisionWorld->retiredLines = realloc(collisionWorld->retiredLines,
+                                           size * sizeof(Line*));
+  }
+  collisionWorld->retiredLines[collisionWorld->numOfRetiredLines++] = line;
+}
+
+void CollisionWorld_addRetiredLines(CollisionWorld* collisionWorld,
+                                    const Line *lines,
+                                    const unsigned int count) {
+  Line *slots = CollisionWorld_reserveLines(collisionWorld, count);
+  memcpy(slots, lines, count * sizeof(Line));
+  collisionWorld->chunks[collisionWorld->numOfChunks - 1].used += count;
+  for (unsigned int i = 0; i < count; i++) {
+    assert(slots[i].kind == RETIRED_LINE);
+    pushRetiredLine(collisionWorld, &slots[i]);
+  }
+}
+
+Line* CollisionWorld_insertLine(CollisionWorld* collisionWorld,
+                                const Line *line) {
+  if (line->kind != DYNAMIC_LINE || collisionWorld->lineSetPins != 0) {
+    return NULL;
+  }
+
+  Line *slot;
+  if (collisionWorld->numOfRetiredLines > 0) {
+    slot = collisionWorld->retiredLines[--collisionWorld->numOfRetiredLines];
+    // Keep the id, and keep counting velocity versions from where the
+    // retired line left off, so certificates naming this storage are stale.
+    unsigned int id = slot->id;
+    unsigned int velocityVersion = slot->velocityVersion;
+    *slot = *line;
+    slot->id = id;
+    slot->velocityVersion = velocityVersion;
+    // clears the certificates and bumps the velocity version
+    updateLineFuturePoints(slot, collisionWorld->timeStep);
+    appendLine(collisionWorld, slot);
+  } else {
+    slot = CollisionWorld_reserveLines(collisionWorld, 1);
+    *slot = *line;
+    slot->id = collisionWorld->nextId;
+    updateLineFuturePoints(slot, collisionWorld->timeStep);
+    CollisionWorld_commitLines(collisionWorld, slot, 1);
+  }
+  insertQuadtreeLine(collisionWorld->quadtree, slot,
+                     collisionWorld->maxLinesPerNode);
+  return slot;
+}
+
+bool CollisionWorld_removeLine(CollisionWorld* collisionWorld, Line *line) {
+  if (line->kind != DYNAMIC_LINE || collisionWorld->lineSetPins != 0) {
+    return false;
+  }
+  removeQuadtreeLine(line);
+
+  // move the last line into the hole
+  Line *last = collisionWorld->lines[--collisionWorld->numOfLines];
+  collisionWorld->lines[line->index] = last;
+  last->index = line->index;
+
+  line->kind = RETIRED_LINE;
+  pushRetiredLine(collisionWorld, line);
+  return true;
 }
 
 Line* CollisionWorld_getLine(CollisionWorld* collisionWorld,
@@ -79,37 +281,123 @@ Line* CollisionWorld_getLine(CollisionWorld* collisionWorld,
   return collisionWorld->lines[index];
 }
 
-void CollisionWorld_updateLines(CollisionWorld* collisionWorld,
-		IntersectionEventListReducer * X) {
-
+void CollisionWorld_updateLines(CollisionWorld* collisionWorld) {
+	CollisionWorld_findIntersections(collisionWorld);
+	CollisionWorld_advance(collisionWorld);
+}
 
+void CollisionWorld_findIntersections(CollisionWorld* collisionWorld) {
 	LineNode * lineNode = NULL;
+	MEMORY_BEGIN_FRAME(collisionWorld);
+	PHASE_TIMER_START(&collisionWorld->phaseTimers);
+	TRACE_BEGIN(find);
+	collisionWorld->frame++;
 	// find all line line collisions:
-	traverseQuadtree(globalQuadtree, X, lineNode);
+	traverseQuadtree(collisionWorld->quadtree, collisionWorld, lineNode);
+	PHASE_TIMER_STOP(&collisionWorld->phaseTimers, PHASE_TRAVERSE_QUADTREE);
+	TRACE_BEGIN(staticCollisions);
+	CollisionWorld_detectStaticCollisions(collisionWorld);
+	TRACE_END(staticCollisions, "detectStaticCollisions", "lines",
+	          collisionWorld->numOfLines);
+	IntersectionEventList * events = &REDUCER_VIEW(collisionWorld->events);
+	collisionWorld->numNarrowPhaseTests += events->narrowPhaseTests;
+	collisionWorld->numNarrowPhaseSkips += events->narrowPhaseSkips;
+	collisionWorld->numBoxRejects += events->boxRejects;
+	collisionWorld->numEvents += events->numEvents;
+	PHASE_TIMER_STOP(&collisionWorld->phaseTimers, PHASE_STATIC_COLLISIONS);
+	TRACE_END(find, "findIntersections", "frame", collisionWorld->frame);
+}
 
-	collisionWorld->numLineLineCollisions += processCollisionList(X->value, collisionWorld);
+void CollisionWorld_advance(CollisionWorld* collisionWorld) {
+	IntersectionEventList * events = &REDUCER_VIEW(collisionWorld->events);
+	// whatever ran since finding the events is not part of the frame
+	PHASE_TIMER_START(&collisionWorld->phaseTimers);
+	TRACE_BEGIN(advance);
+	collisionWorld->numLineLineCollisions +=
+	    processCollisionList(*events, collisionWorld);
+	*events = IntersectionEventList_make();
+	PHASE_TIMER_STOP(&collisionWorld->phaseTimers, PHASE_PROCESS_COLLISIONS);
 
 	// update the positions of all the lines in the collisionworld.
+	TRACE_BEGIN(updatePosition);
 	CollisionWorld_updatePosition(collisionWorld);
+	TRACE_END(updatePosition, "updatePosition", "activeLines",
+	          collisionWorld->numActiveLines);
+	PHASE_TIMER_STOP(&collisionWorld->phaseTimers, PHASE_UPDATE_POSITION);
 
 	//then find and process all wall line collisions
-	collisionWorld->numLineWallCollisions += getWallCollisions(globalQuadtree);
-
-  	updateNode(globalQuadtree);
-	attachBuffers(globalQuadtree);
+	TRACE_BEGIN(walls);
+	const unsigned int wallCollisions =
+	    getWallCollisions(collisionWorld->quadtree, collisionWorld->timeStep);
+	collisionWorld->numLineWallCollisions += wallCollisions;
+	TRACE_END(walls, "getWallCollisions", "collisions", wallCollisions);
+	PHASE_TIMER_STOP(&collisionWorld->phaseTimers, PHASE_WALL_COLLISIONS);
+
+	TRACE_BEGIN(updateNode);
+  	updateNode(collisionWorld->quadtree, collisionWorld->timeStep);
+	TRACE_END(updateNode, "updateNode", "frame", collisionWorld->frame);
+	PHASE_TIMER_STOP(&collisionWorld->phaseTimers, PHASE_UPDATE_NODE);
+	TRACE_BEGIN(attachBuffers);
+	attachBuffers(collisionWorld->quadtree, collisionWorld->maxLinesPerNode);
+	TRACE_END(attachBuffers, "attachBuffers", "frame", collisionWorld->frame);
+	PHASE_TIMER_STOP(&collisionWorld->phaseTimers, PHASE_ATTACH_BUFFERS);
+	PHASE_TIMER_END_FRAME(&collisionWorld->phaseTimers);
+	MEMORY_END_FRAME(collisionWorld);
+	if (collisionWorld->publishedFrames != NULL) {
+		TRACE_BEGIN(publish);
+		PublishedFrames_publish(collisionWorld->publishedFrames, collisionWorld);
+		TRACE_END(publish, "publishFrame", "lines", collisionWorld->numOfLines);
+	}
+	TRACE_END(advance, "advance", "frame", collisionWorld->frame);
 }
 
 void CollisionWorld_updatePosition(CollisionWorld* collisionWorld) {
-//  double t = collisionWorld->timeStep;
-  for (int i = 0; i < collisionWorld->numOfLines; i++) {
-    Line *line = collisionWorld->lines[i];
+  CILK_C_REDUCER_OPADD(numActiveLines, uint, 0);
+  CILK_C_REGISTER_REDUCER(numActiveLines);
+  const double timeStep = collisionWorld->timeStep;
+
+  // Walk each contiguous chunk of line storage block by block, skipping
+  // sleeping, static and retired lines.
+  for (unsigned int c = 0; c < collisionWorld->numOfChunks; c++) {
+    Line *lineData = collisionWorld->chunks[c].lines;
+    const unsigned int numOfLines = collisionWorld->chunks[c].used;
+    const unsigned int numBlocks =
+        (numOfLines + LINE_UPDATE_BLOCK - 1) / LINE_UPDATE_BLOCK;
+    cilk_for (unsigned int block = 0; block < numBlocks; block++) {
+      TRACE_BEGIN(block);
+      const unsigned int begin = block * LINE_UPDATE_BLOCK;
+      const unsigned int end = (begin + LINE_UPDATE_BLOCK < numOfLines) ?
+          begin + LINE_UPDATE_BLOCK : numOfLines;
+      unsigned int blockActiveLines = 0;
+      for (unsigned int i = begin; i < end; i++) {
+        Line *line = &lineData[i];
+        if (line->asleep || line->kind != DYNAMIC_LINE) {
+          continue;
+        }
+        advanceLine(line, timeStep);
+        blockActiveLines += updateLineSleepState(line, timeStep);
+      }
+      REDUCER_VIEW(numActiveLines) += blockActiveLines;
+      TRACE_END(block, "updatePositionBlock", "activeLines", blockActiveLines);
+    }
+  }
 
-    //When we updatePosition, calculate what the position will be next time step
-    line->p1 = line->fut_p1;
-    line->p2 = line->fut_p2;
+  collisionWorld->numActiveLines = numActiveLines.value;
+  CILK_C_UNREGISTER_REDUCER(numActiveLines);
+}
 
-    //Will this change p1/p2?
-    updateLineFuturePoints(line);
+void CollisionWorld_detectStaticCollisions(CollisionWorld* collisionWorld) {
+  if (collisionWorld->staticQuadtree == NULL) {
+    return;
+  }
+  // The static index is never modified, so every dynamic line can query it
+  // in parallel.
+  cilk_for (unsigned int i = 0; i < collisionWorld->numOfLines; i++) {
+    Line *line = collisionWorld->lines[i];
+    if (line->kind == STATIC_LINE || line->asleep) {
+      continue;
+    }
+    queryStaticIndex(collisionWorld->staticQuadtree, line, collisionWorld);
   }
 }
 
@@ -241,37 +529,55 @@ int processCollisionList(IntersectionEventList intersectionEventList, CollisionW
 	  IntersectionEventNode * curNode = startNode;
 	  intersectionEventList.head = startNode;
 
+	  TRACE_BEGIN(solve);
 	  while (curNode != NULL) {
 	    CollisionWorld_collisionSolver(collisionWorld, curNode->l1, curNode->l2,
 	                                   curNode->intersectionType);
 	    curNode = curNode->next;
 	    count ++;
 	  }
+	  TRACE_END(solve, "solve", "events", count);
 
 	  IntersectionEventList_deleteNodes(&intersectionEventList);
    	  return count;
 }
 
-void CollisionWorld_detectIntersection(CollisionWorld* collisionWorld) {
+IntersectionEventList CollisionWorld_findIntersectionsBruteForce(
+    CollisionWorld* collisionWorld) {
   IntersectionEventList intersectionEventList = IntersectionEventList_make();
 
   // Test all line-line pairs to see if they will intersect before the
-  // next time step.
+  // next time step.  Pairs of lines that can't move (static or asleep) are
+  // skipped, as the quadtree path skips them.
   for (int i = 0; i < collisionWorld->numOfLines; i++) {
     Line *l1 = collisionWorld->lines[i];
+    const bool l1Resting = l1->kind == STATIC_LINE || l1->asleep;
 
     for (int j = i + 1; j < collisionWorld->numOfLines; j++) {
       Line *l2 = collisionWorld->lines[j];
+      if (l1Resting && (l2->kind == STATIC_LINE || l2->asleep)) {
+        continue;
+      }
 
+      // lines[] is not in id order once lines have been removed
+      Line *first = l1->id < l2->id ? l1 : l2;
+      Line *second = l1->id < l2->id ? l2 : l1;
+      intersectionEventList.narrowPhaseTests++;
       IntersectionType intersectionType =
-          intersect(l1, l2, collisionWorld->timeStep);
+          intersect(first, second, collisionWorld->timeStep);
       if (intersectionType != NO_INTERSECTION) {
-        IntersectionEventList_appendNode(&intersectionEventList, l1, l2,
+        IntersectionEventList_appendNode(&intersectionEventList, first, second,
                                          intersectionType);
-        collisionWorld->numLineLineCollisions++;
       }
     }
   }
+  return intersectionEventList;
+}
+
+void CollisionWorld_detectIntersection(CollisionWorld* collisionWorld) {
+  IntersectionEventList intersectionEventList =
+      CollisionWorld_findIntersectionsBruteForce(collisionWorld);
+  collisionWorld->numLineLineCollisions += intersectionEventList.numEvents;
 
   // Sort the intersection event list.
   IntersectionEventNode* startNode = intersectionEventList.head;
@@ -302,6 +608,10 @@ void CollisionWorld_detectIntersection(CollisionWorld* collisionWorld) {
   IntersectionEventList_deleteNodes(&intersectionEventList);
 }
 
+unsigned int CollisionWorld_getNumActiveLines(CollisionWorld* collisionWorld) {
+  return collisionWorld->numActiveLines;
+}
+
 unsigned int CollisionWorld_getNumLineWallCollisions(
     CollisionWorld* collisionWorld) {
   return collisionWorld->numLineWallCollisions;
@@ -315,6 +625,8 @@ unsigned int CollisionWorld_getNumLineLineCollisions(
 void CollisionWorld_collisionSolver(CollisionWorld* collisionWorld,
                                     Line *l1, Line *l2,
                                     IntersectionType intersectionType) {
+  wakeLine(l1);
+  wakeLine(l2);
 
   // Despite our efforts to determine whether lines will intersect ahead
   // of time (and to modify their velocities appropriately), our
@@ -332,27 +644,31 @@ void CollisionWorld_collisionSolver(CollisionWorld* collisionWorld,
 	double l2_p2_p = l2->length - l2_p1_p;
 
 	//Pre-computing distance to intersection
-    if (l1_p1_p < l1_p2_p) {
+    if (l1->kind == STATIC_LINE) {
+      // Static lines have infinite mass and never move.
+    } else if (l1_p1_p < l1_p2_p) {
       l1->velocity = Vec_multiply(Vec_divide(Vec_subtract(l1->p2, p), l1_p2_p),
                                   Vec_length(l1->velocity));
 
-	  updateLineFuturePoints(l1);
+	  updateLineFuturePoints(l1, collisionWorld->timeStep);
     } else {
       l1->velocity = Vec_multiply(Vec_divide(Vec_subtract(l1->p1, p), l1_p1_p),
                                   Vec_length(l1->velocity));
 
-      updateLineFuturePoints(l1);
+      updateLineFuturePoints(l1, collisionWorld->timeStep);
     }
-    if (l2_p1_p < l2_p2_p) {
+    if (l2->kind == STATIC_LINE) {
+      // Static lines have infinite mass and never move.
+    } else if (l2_p1_p < l2_p2_p) {
       l2->velocity = Vec_multiply(Vec_divide(Vec_subtract(l2->p2, p), l2_p2_p),
                                   Vec_length(l2->velocity));
 
-      updateLineFuturePoints(l2);
+      updateLineFuturePoints(l2, collisionWorld->timeStep);
     } else {
       l2->velocity = Vec_multiply(Vec_divide(Vec_subtract(l2->p1, p), l2_p1_p),
                                   Vec_length(l2->velocity));
 
-      updateLineFuturePoints(l2);
+      updateLineFuturePoints(l2, collisionWorld->timeStep);
     }
     return;
   }
@@ -382,22 +698,37 @@ void CollisionWorld_collisionSolver(CollisionWorld* collisionWorld,
 
   // Perform the collision calculation (computes the new velocities along
   // the direction normal to the collision face such that momentum and
-  // kinetic energy are conserved).
-  double newV1Normal = ((m1 - m2) / (m1 + m2)) * v1Normal
-      + (2 * m2 / (m1 + m2)) * v2Normal;
-  double newV2Normal = (2 * m1 / (m1 + m2)) * v1Normal
-      + ((m2 - m1) / (m2 + m1)) * v2Normal;
+  // kinetic energy are conserved).  A static line has infinite mass, so
+  // the other line simply reflects off it.
+  double newV1Normal;
+  double newV2Normal;
+  if (l2->kind == STATIC_LINE) {
+    newV1Normal = 2 * v2Normal - v1Normal;
+    newV2Normal = v2Normal;
+  } else if (l1->kind == STATIC_LINE) {
+    newV1Normal = v1Normal;
+    newV2Normal = 2 * v1Normal - v2Normal;
+  } else {
+    newV1Normal = ((m1 - m2) / (m1 + m2)) * v1Normal
+        + (2 * m2 / (m1 + m2)) * v2Normal;
+    newV2Normal = (2 * m1 / (m1 + m2)) * v1Normal
+        + ((m2 - m1) / (m2 + m1)) * v2Normal;
+  }
 
   // Combine the resulting velocities.
-  l1->velocity = Vec_add(Vec_multiply(normal, newV1Normal),
-                         Vec_multiply(face, v1Face));
+  if (l1->kind != STATIC_LINE) {
+    l1->velocity = Vec_add(Vec_multiply(normal, newV1Normal),
+                           Vec_multiply(face, v1Face));
 
-  updateLineFuturePoints(l1);
+    updateLineFuturePoints(l1, collisionWorld->timeStep);
+  }
 
-  l2->velocity = Vec_add(Vec_multiply(normal, newV2Normal),
-                         Vec_multiply(face, v2Face));
+  if (l2->kind != STATIC_LINE) {
+    l2->velocity = Vec_add(Vec_multiply(normal, newV2Normal),
+                           Vec_multiply(face, v2Face));
 
-  updateLineFuturePoints(l2);
+    updateLineFuturePoints(l2, collisionWorld->timeStep);
+  }
 
   return;
 }
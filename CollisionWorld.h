@@ -27,23 +27,111 @@
 #include "./Line.h"
 #include "./IntersectionDetection.h"
 #include "./IntersectionEventList.h"
+#include "./PhaseTimer.h"
 
 typedef CILK_C_DECLARE_REDUCER(IntersectionEventList) IntersectionEventListReducer;
 
+// Lines per chunk of line storage added as the world grows.
+#define LINE_CHUNK_LINES 4096
+
+// The time step, and the number of lines at which a quadtree node splits,
+// of a new CollisionWorld.
+#define DEFAULT_TIME_STEP 0.5
+#define DEFAULT_MAX_LINES_PER_NODE 50
+
+// A chunk of line storage.  Chunks are never moved, so Line* pointers stay
+// valid as lines are added.
+struct LineChunk {
+  Line* lines;
+  unsigned int used;  // slots handed out, including retired ones
+  unsigned int capacity;
+};
+typedef struct LineChunk LineChunk;
+
+// A world owns its lines, its quadtrees, their parameters and its event
+// reducer, so independent worlds can be simulated concurrently on the same
+// Cilk workers.
 struct CollisionWorld {
-  // Time step used for simulation
+  // Time step used for simulation; change it with
+  // CollisionWorld_setTimeStep.
   double timeStep;
 
-  // Container that holds all the lines as an array of Line* lines.
-  // This CollisionWorld owns the Line* lines.
+  // Quadtree nodes holding this many lines or more are split.  Set before
+  // CollisionWorld_buildQuadtrees.
+  unsigned int maxLinesPerNode;
+
+  // Storage for all the lines, walked chunk by chunk in blocks by the
+  // per-frame position update.  The first chunk holds the initial capacity.
+  LineChunk* chunks;
+  unsigned int numOfChunks;
+  unsigned int maxChunks;
+
+  // Container that holds all the live lines as an array of Line* lines.
+  // lines[i] points into the chunks and lines[i]->index == i.
   Line** lines;
   unsigned int numOfLines;
+  unsigned int capacity;
+
+  // Storage of removed lines, reused with their ids by
+  // CollisionWorld_insertLine.
+  Line** retiredLines;
+  unsigned int numOfRetiredLines;
+
+  // One more than the largest id handed out.
+  unsigned int nextId;
+
+  // Readers that rely on lines[] staying the same lines, such as an open
+  // trajectory.  Lines can't be inserted or removed while it is nonzero.
+  unsigned int lineSetPins;
+
+  // The static lines (also present in lines), and the immutable quadtree
+  // indexing them.  The index is built once after loading.
+  Line** staticLines;
+  unsigned int numOfStaticLines;
+  unsigned int staticCapacity;
+  struct quadtree_node* staticQuadtree;
+
+  // The quadtree of the moving lines, updated every frame.
+  struct quadtree_node* quadtree;
+
+  // Frame number used to expire pair certificates; advanced once per frame
+  // by CollisionWorld_findIntersections.
+  unsigned int frame;
+
+  // This frame's line-line intersection events, collected by the parallel
+  // traversal.  Registered for the life of the world.
+  IntersectionEventListReducer events;
+
+  // The lines as of the last frame, for readers on other threads; NULL
+  // unless CollisionWorld_publishFrames was called.
+  struct PublishedFrames* publishedFrames;
+
+  // Differential_updateLines's totals; NULL until it first checks a frame.
+  struct DifferentialTotals* differential;
+
+  // Number of lines that were awake after the last position update.
+  unsigned int numActiveLines;
 
   // Record the total number of line-wall collisions.
   unsigned int numLineWallCollisions;
 
   // Record the total number of line-line intersections.
   unsigned int numLineLineCollisions;
+
+  // Record the total number of narrow-phase intersect() calls, and the
+  // number avoided by pair certificates.
+  uint64_t numNarrowPhaseTests;
+  uint64_t numNarrowPhaseSkips;
+
+  // Record the total number of candidate pairs rejected by the swept-box
+  // prefilter, and of intersection events found.
+  uint64_t numBoxRejects;
+  uint64_t numEvents;
+
+#ifdef PHASE_TIMING
+  // Time spent in each phase of CollisionWorld_updateLines, frame by frame.
+  PhaseTimers phaseTimers;
+#endif
 };
 typedef struct CollisionWorld CollisionWorld;
 
@@ -54,17 +142,71 @@ void CollisionWorld_delete(CollisionWorld* collisionWorld);
 // Return the total number of lines in the box.
 unsigned int CollisionWorld_getNumOfLines(CollisionWorld* collisionWorld);
 
-// Add a line into the box.  Must be under capacity.
-// This CollisionWorld becomes owner of the Line* line.
-void CollisionWorld_addLine(CollisionWorld* collisionWorld, Line *line);
+// Return the number of lines that were awake during the last frame.
+unsigned int CollisionWorld_getNumActiveLines(CollisionWorld* collisionWorld);
+
+// Add a line into the box, before the quadtrees are built.
+// The line is copied into the CollisionWorld's line storage.
+void CollisionWorld_addLine(CollisionWorld* collisionWorld, const Line *line);
+
+// Reserve count contiguous lines in the line storage, to be initialized in
+// place by the caller.  Storage grows by a chunk if needed.
+Line* CollisionWorld_reserveLines(CollisionWorld* collisionWorld,
+                                  const unsigned int count);
+
+// Add count lines, starting at first, that were reserved and initialized.
+void CollisionWorld_commitLines(CollisionWorld* collisionWorld, Line *first,
+                                const unsigned int count);
+
+// Copy count retired lines into the storage, to be reused by
+// CollisionWorld_insertLine as if lines[0 ... count - 1] had been removed
+// in that order.  For restoring a saved world.
+void CollisionWorld_addRetiredLines(CollisionWorld* collisionWorld,
+                                    const Line *lines,
+                                    const unsigned int count);
+
+// Change the time step, recomputing every line's future position.  Call it
+// before CollisionWorld_buildQuadtrees.
+void CollisionWorld_setTimeStep(CollisionWorld* collisionWorld,
+                                double timeStep);
+
+// Build the quadtree of the moving lines and the static index, once all the
+// initial lines are added.
+void CollisionWorld_buildQuadtrees(CollisionWorld* collisionWorld);
+
+// Publish the lines at the end of every frame from now on, for readers on
+// other threads (see PublishedFrames.h).
+void CollisionWorld_publishFrames(CollisionWorld* collisionWorld);
+
+// Add a dynamic line between frames, after the quadtree is built.  The line
+// is copied into recycled or new storage, gets a recycled or new id, and is
+// inserted into the quadtree.  Returns the stored line, or NULL for a
+// static line, since the static index is immutable, or while the line set
+// is pinned.
+Line* CollisionWorld_insertLine(CollisionWorld* collisionWorld,
+                                const Line *line);
+
+// Remove a dynamic line between frames: unlink it from the quadtree and
+// retire its storage and id for reuse.  Pointers to it must not be used
+// afterwards.  Returns false for a static line, or while the line set is
+// pinned.
+bool CollisionWorld_removeLine(CollisionWorld* collisionWorld, Line *line);
 
 // Get a line from box.
 Line* CollisionWorld_getLine(CollisionWorld* collisionWorld,
                              const unsigned int index);
 
-// Update lines' situation in the box.
-void CollisionWorld_updateLines(CollisionWorld* collisionWorld,
-		IntersectionEventListReducer * X);
+// Update lines' situation in the box: CollisionWorld_findIntersections,
+// then CollisionWorld_advance.
+void CollisionWorld_updateLines(CollisionWorld* collisionWorld);
+
+// Find this frame's line-line intersection events into the world's events,
+// with the quadtree and the static index.
+void CollisionWorld_findIntersections(CollisionWorld* collisionWorld);
+
+// Solve the events, move the lines, bounce them off the walls and update
+// the quadtree for the next frame.
+void CollisionWorld_advance(CollisionWorld* collisionWorld);
 
 // Update position of lines.
 void CollisionWorld_updatePosition(CollisionWorld* collisionWorld);
@@ -72,7 +214,12 @@ void CollisionWorld_updatePosition(CollisionWorld* collisionWorld);
 // Handle line-wall collision.
 void CollisionWorld_lineWallCollision(CollisionWorld* collisionWorld);
 
-// Detect line-line intersection.
+// Find this frame's line-line intersection events by testing every pair of
+// lines, unsorted.  narrowPhaseTests counts the intersect() calls.
+IntersectionEventList CollisionWorld_findIntersectionsBruteForce(
+    CollisionWorld* collisionWorld);
+
+// Detect and solve line-line intersections by brute force.
 void CollisionWorld_detectIntersection(CollisionWorld* collisionWorld);
 
 // Get total number of line-wall collisions.
@@ -83,12 +230,18 @@ unsigned int CollisionWorld_getNumLineWallCollisions(
 unsigned int CollisionWorld_getNumLineLineCollisions(
     CollisionWorld* collisionWorld);
 
+// Test every awake dynamic line against the static index.
+void CollisionWorld_detectStaticCollisions(CollisionWorld* collisionWorld);
+
 // Update the two lines based on their intersection event.
 // Precondition: compareLines(l1, l2) < 0 must be true.
 void CollisionWorld_collisionSolver(CollisionWorld* collisionWorld, Line *l1,
                                     Line *l2,
                                     IntersectionType intersectionType);
 
+// Sort an event list by (l1, l2) id, in place.
+void mergeSort(IntersectionEventNode ** headNode);
+
 int processCollisionList(IntersectionEventList intersectionEventList, CollisionWorld *collisionWorld);
 
 #endif  // COLLISIONWORLD_H_
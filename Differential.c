@@ -0,0 +1,152 @@
+/*
+ * Differential.c -- check the quadtree detector against brute force
+ */
+
+#include "./Differential.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "./fasttime.h"
+
+static const char *intersectionTypeNames[] = {
+  "none", "L1_WITH_L2", "L2_WITH_L1", "ALREADY_INTERSECTED"
+};
+
+// A world's totals over all its checked frames.
+struct DifferentialTotals {
+  unsigned int numFrames;
+  unsigned int numDivergentFrames;
+  uint64_t numDifferences;
+  uint64_t quadtreeEvents;
+  uint64_t bruteForceEvents;
+  uint64_t quadtreeCandidates;
+  uint64_t quadtreeTests;
+  uint64_t bruteForceTests;
+  double quadtreeSeconds;
+  double bruteForceSeconds;
+};
+typedef struct DifferentialTotals DifferentialTotals;
+
+static void reportDifference(bool report, unsigned int difference,
+                             const char *what, IntersectionEventNode *event) {
+  if (report && difference < DIFFERENTIAL_MAX_REPORTS) {
+    printf("  lines %u and %u %s (%s)\n", event->l1->id, event->l2->id, what,
+           intersectionTypeNames[event->intersectionType]);
+  }
+}
+
+// Walks the two sorted lists side by side, printing the first differences
+// if report is set.  Returns the number of events missing from either list
+// or found with different types.
+static unsigned int compareEvents(bool report,
+                                  IntersectionEventNode *quadtree,
+                                  IntersectionEventNode *bruteForce) {
+  unsigned int differences = 0;
+  while (quadtree != NULL || bruteForce != NULL) {
+    int order = quadtree == NULL ? 1 : bruteForce == NULL ? -1
+        : IntersectionEventNode_compareData(quadtree, bruteForce);
+    if (order < 0) {
+      reportDifference(report, differences++, "only found by the quadtree",
+                       quadtree);
+      quadtree = quadtree->next;
+    } else if (order > 0) {
+      reportDifference(report, differences++, "only found by brute force",
+                       bruteForce);
+      bruteForce = bruteForce->next;
+    } else {
+      if (quadtree->intersectionType != bruteForce->intersectionType) {
+        reportDifference(report, differences, "found by the quadtree",
+                         quadtree);
+        reportDifference(report, differences++, "but brute force finds",
+                         bruteForce);
+      }
+      quadtree = quadtree->next;
+      bruteForce = bruteForce->next;
+    }
+  }
+  return differences;
+}
+
+void Differential_updateLines(CollisionWorld* collisionWorld,
+                              unsigned int frame) {
+  const fasttime_t quadtreeStart = gettime();
+  CollisionWorld_findIntersections(collisionWorld);
+  const fasttime_t quadtreeEnd = gettime();
+  IntersectionEventList bruteForce =
+      CollisionWorld_findIntersectionsBruteForce(collisionWorld);
+  const fasttime_t bruteForceEnd = gettime();
+
+  // both sorted the way processCollisionList sorts
+  IntersectionEventList *events = &REDUCER_VIEW(collisionWorld->events);
+  mergeSort(&events->head);
+  events->tail = events->head;
+  while (events->tail != NULL && events->tail->next != NULL) {
+    events->tail = events->tail->next;
+  }
+  mergeSort(&bruteForce.head);
+
+  const unsigned int differences =
+      compareEvents(false, events->head, bruteForce.head);
+  const double quadtreeTime = tdiff(quadtreeStart, quadtreeEnd);
+  const double bruteForceTime = tdiff(quadtreeEnd, bruteForceEnd);
+  const uint64_t candidates = events->boxRejects
+      + events->narrowPhaseTests + events->narrowPhaseSkips;
+  printf("Frame %u: quadtree %.1fus (%" PRIu64 " candidate pairs, %" PRIu64
+         " intersect() calls), brute force %.1fus (%" PRIu64 " intersect() "
+         "calls), %.1fx, %" PRIu64 " events",
+         frame, 1e6 * quadtreeTime, candidates, events->narrowPhaseTests,
+         1e6 * bruteForceTime, bruteForce.narrowPhaseTests,
+         quadtreeTime > 0 ? bruteForceTime / quadtreeTime : 0.0,
+         events->numEvents);
+  if (differences != 0) {
+    printf(", %u DIFFERENCES (brute force found %" PRIu64 " events)",
+           differences, bruteForce.numEvents);
+  }
+  printf("\n");
+  if (differences != 0) {
+    compareEvents(true, events->head, bruteForce.head);
+  }
+
+  if (collisionWorld->differential == NULL) {
+    collisionWorld->differential = calloc(1, sizeof(DifferentialTotals));
+  }
+  DifferentialTotals *totals = collisionWorld->differential;
+  totals->numFrames++;
+  totals->numDivergentFrames += differences != 0;
+  totals->numDifferences += differences;
+  totals->quadtreeEvents += events->numEvents;
+  totals->bruteForceEvents += bruteForce.numEvents;
+  totals->quadtreeCandidates += candidates;
+  totals->quadtreeTests += events->narrowPhaseTests;
+  totals->bruteForceTests += bruteForce.narrowPhaseTests;
+  totals->quadtreeSeconds += quadtreeTime;
+  totals->bruteForceSeconds += bruteForceTime;
+
+  IntersectionEventList_deleteNodes(&bruteForce);
+  CollisionWorld_advance(collisionWorld);
+}
+
+unsigned int Differential_finish(CollisionWorld* collisionWorld) {
+  DifferentialTotals totals = {0};
+  if (collisionWorld->differential != NULL) {
+    totals = *collisionWorld->differential;
+    free(collisionWorld->differential);
+    collisionWorld->differential = NULL;
+  }
+  printf("---- DIFFERENTIAL ----\n");
+  printf("%u frames, %u with differences (%" PRIu64 " differences)\n",
+         totals.numFrames, totals.numDivergentFrames, totals.numDifferences);
+  printf("Events: %" PRIu64 " by the quadtree, %" PRIu64 " by brute force\n",
+         totals.quadtreeEvents, totals.bruteForceEvents);
+  printf("Quadtree: %fs, %" PRIu64 " candidate pairs, %" PRIu64
+         " intersect() calls\n", totals.quadtreeSeconds,
+         totals.quadtreeCandidates, totals.quadtreeTests);
+  printf("Brute force: %fs, %" PRIu64 " intersect() calls\n",
+         totals.bruteForceSeconds, totals.bruteForceTests);
+  printf("Speedup: %.1fx\n", totals.quadtreeSeconds > 0
+         ? totals.bruteForceSeconds / totals.quadtreeSeconds : 0.0);
+  printf("---- END DIFFERENTIAL ----\n");
+  return totals.numDivergentFrames;
+}
@@ -0,0 +1,30 @@
+/*
+ * Differential.h -- check the quadtree detector against brute force
+ *
+ * Runs each frame's collision detection twice on the same state: once
+ * through the quadtree and static index, and once by testing every pair of
+ * lines.  The two sorted event lists are compared, and each frame reports
+ * both detection times, the speedup, and the pairs each path examined.
+ * Only the quadtree's events are solved, so the simulation is the same as
+ * a normal run.  The totals are kept per world, so worlds can be checked
+ * concurrently.
+ */
+
+#ifndef DIFFERENTIAL_H_
+#define DIFFERENTIAL_H_
+
+#include "./CollisionWorld.h"
+
+// Differences printed per frame; the rest are only counted.
+#define DIFFERENTIAL_MAX_REPORTS 8
+
+// CollisionWorld_updateLines, checking the events against brute force and
+// printing a line for the frame.
+void Differential_updateLines(CollisionWorld* collisionWorld,
+                              unsigned int frame);
+
+// Print collisionWorld's totals over all its checked frames, and forget
+// them.  Returns the number of frames whose events differed.
+unsigned int Differential_finish(CollisionWorld* collisionWorld);
+
+#endif  // DIFFERENTIAL_H_
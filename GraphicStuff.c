@@ -22,6 +22,8 @@
 
 #include "./GraphicStuff.h"
 
+#include <pthread.h>
+#include <sched.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -29,13 +31,22 @@
 #include "./Line.h"
 #include "./Quadtree.h"
 #include "./LineDemo.h"
-#include "./LineDemo.h"
+#include "./PublishedFrames.h"
+#include "./Trajectory.h"
 #include <cilk/cilk.h>
 #include <cilk/reducer.h>
 
 static LineDemo *gLineDemo = NULL;
+static Trajectory *gTrajectory = NULL;
 XSegment *segments = NULL;
 XSegment *gray_segments = NULL;
+static unsigned int segmentsCapacity = 0;
+
+// The simulation runs on its own thread and publishes every frame; this
+// thread draws the last published frame while the next one is computed.
+static bool gImageOnlyFlag;
+static bool simulationDone = false;  // set atomically by the simulation
+static unsigned int framesDrawn = 0;
 
 
 Display *display;
@@ -50,44 +61,32 @@ int visibility;
 
 int windowwidth;
 int windowheight;
+// Created once by graphicInit
+static GC gray;
+static GC red;
 
-static void drawLineSegments(Display *display, Drawable drawable) {
-  Line *line;
+static void drawLineSegments(Display *display, Drawable drawable,
+                             const PublishedFrame *frame) {
+  const PublishedLine *line;
   unsigned int nsegments;
   window_dimension px1;
   window_dimension py1;
   window_dimension px2;
   window_dimension py2;
 
-  Colormap cmap;
-  XGCValues gcval;
-  XColor color;
-  XColor ignore;
-  int64_t fgcolor;
-  GC gray;
-  GC red;
-
-  cmap = DefaultColormap(display, screen);
-  XAllocNamedColor(display, cmap, "gray", &color, &ignore);
-  fgcolor = color.pixel;
-  gcval.foreground = fgcolor;
-  gray = XCreateGC(display, window, GCForeground, &gcval);
-
-  XAllocNamedColor(display, cmap, "dark red", &color, &ignore);
-  fgcolor = color.pixel;
-  gcval.foreground = fgcolor;
-  red = XCreateGC(display, window, GCForeground, &gcval);
-
-  nsegments = LineDemo_getNumOfLines(gLineDemo);
-  if (segments == NULL || gray_segments == NULL) {
+  nsegments = frame->numOfLines;
+  if (nsegments > segmentsCapacity) {
+    free(segments);
+    free(gray_segments);
     segments = malloc(nsegments * sizeof(XSegment));
     gray_segments = malloc(nsegments * sizeof(XSegment));
+    segmentsCapacity = nsegments;
   }
   XClearWindow(display, window);
   int red_segments_count = 0;
   int gray_segments_count = 0;
   for (unsigned int i = 0; i < nsegments; i++) {
-    line = LineDemo_getLine(gLineDemo, i);
+    line = &frame->lines[i];
 
     // Convert box coordinates to window coordinates.
     boxToWindow(&px1, &py1, line->p1.x, line->p1.y);
@@ -191,15 +190,48 @@ static void checkEvent() {
   }
 }
 
-static void graphicMainLoop(bool imageOnlyFlag, IntersectionEventListReducer * reducer) {
-	while ((gLineDemo->count <= gLineDemo->numFrames) | imageOnlyFlag) {
+static void* simulationMain(void *unused) {
+	while ((gLineDemo->count <= gLineDemo->numFrames) | gImageOnlyFlag) {
+		CollisionWorld_updateLines(gLineDemo->collisionWorld);
+		gLineDemo->count++;
+	}
+	__atomic_store_n(&simulationDone, true, __ATOMIC_SEQ_CST);
+	return NULL;
+}
+
+static void graphicMainLoop(bool imageOnlyFlag) {
+	PublishedFrames *publishedFrames = gLineDemo->collisionWorld->publishedFrames;
+	gImageOnlyFlag = imageOnlyFlag;
+	pthread_t simulation;
+	if (pthread_create(&simulation, NULL, simulationMain, NULL) != 0) {
+		perror("pthread_create");
+		exit(1);
+	}
+
+	// Draw each frame once.  The simulation stays at most a frame ahead.
+	bool drawn = false;
+	unsigned long long drawnEpoch = 0;
+	while (true) {
 		checkEvent();
-		drawLineSegments(display, window);
-		  CollisionWorld_updateLines(gLineDemo->collisionWorld, reducer);
-		  gLineDemo->count++;
-		  (reducer->value).head = NULL;
-		  (reducer->value).tail = NULL;
-	  }
+		// read before the epoch, so that the last frame is always drawn
+		const bool done = __atomic_load_n(&simulationDone, __ATOMIC_SEQ_CST);
+		if (!drawn || PublishedFrames_epoch(publishedFrames) != drawnEpoch) {
+			const PublishedFrame *frame = PublishedFrames_acquire(publishedFrames);
+			if (gTrajectory != NULL) {
+				Trajectory_writePublishedFrame(gTrajectory, frame);
+			}
+			drawLineSegments(display, window, frame);
+			drawnEpoch = frame->epoch;
+			drawn = true;
+			framesDrawn++;
+			PublishedFrames_release(publishedFrames, frame);
+		} else if (done) {
+			break;
+		} else {
+			sched_yield();
+		}
+	}
+	pthread_join(simulation, NULL);
 //	while (true) {
 //    checkEvent();
 //    drawLineSegments(display, window);
@@ -244,25 +276,41 @@ static void graphicInit(int *argc, char *argv[]) {
 
   XMapWindow(display, window);
 
+  Colormap cmap;
+  XGCValues gcval;
+  XColor color;
+  XColor ignore;
+  cmap = DefaultColormap(display, screen);
+  XAllocNamedColor(display, cmap, "gray", &color, &ignore);
+  gcval.foreground = color.pixel;
+  gray = XCreateGC(display, window, GCForeground, &gcval);
+
+  XAllocNamedColor(display, cmap, "dark red", &color, &ignore);
+  gcval.foreground = color.pixel;
+  red = XCreateGC(display, window, GCForeground, &gcval);
+
   XClearWindow(display, window);
   XSync(display, 0);
 }
 
-void graphicMain(int argc, char *argv[], LineDemo *lineDemo, bool imageOnlyFlag) {
-	globalQuadtree = instantiateRoot(lineDemo->collisionWorld);
-	IntersectionEventListReducer X = CILK_C_INIT_REDUCER(/*type*/ IntersectionEventList,
-	    	IntersectionEventList_reduce, IntersectionEventList_identity, IntersectionEventList_destroy,
-	    	/* initial value */ IntersectionEventList_make());
-	  CILK_C_REGISTER_REDUCER(X);
+void graphicMain(int argc, char *argv[], LineDemo *lineDemo, bool imageOnlyFlag,
+                 Trajectory *trajectory) {
+	CollisionWorld_buildQuadtrees(lineDemo->collisionWorld);
+	CollisionWorld_publishFrames(lineDemo->collisionWorld);
   gLineDemo = lineDemo;
+  gTrajectory = trajectory;
 
   // Initialization
   graphicInit(&argc, argv);
 
   // Entering the rendering loop
-  graphicMainLoop(imageOnlyFlag, &X);
-  CILK_C_UNREGISTER_REDUCER(X);
+  graphicMainLoop(imageOnlyFlag);
+  printf("Rendering: %u frames drawn, the simulation waited %fs for the "
+         "renderer\n", framesDrawn,
+         lineDemo->collisionWorld->publishedFrames->waitSeconds);
 
+  XFreeGC(display, gray);
+  XFreeGC(display, red);
   if (segments != NULL) {
     free(segments);
   }
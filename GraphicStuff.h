@@ -28,8 +28,11 @@
 #include <X11/Xlib.h>
 
 struct LineDemo;
+struct Trajectory;
 
+// Run the simulation on its own thread and draw its frames.  If trajectory
+// isn't NULL, every frame drawn is also recorded in it.
 void graphicMain(int argc, char *argv[], struct LineDemo *lineDemo,
-                 bool imageOnlyFlag);
+                 bool imageOnlyFlag, struct Trajectory *trajectory);
 
 #endif  // GRAPHICSTUFF_H_
@@ -0,0 +1,124 @@
+/*
+ * Headless.c -- run a scene through libquadtree's C API, without X11
+ *
+ * Uses nothing of the simulation but Simulation.h: loads the scene, steps
+ * it in batches of frames, reads every line's position in place after each
+ * batch, and reports the frame rate and the counters.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "./fasttime.h"
+#include "./Simulation.h"
+
+// Reads the positions of the live lines in place and returns their mean
+// midpoint, in *x and *y, and their number.
+static unsigned int meanMidpoint(const Simulation *simulation,
+                                 const SimulationLineLayout *layout,
+                                 double *x, double *y) {
+  unsigned int numLines = 0;
+  *x = 0;
+  *y = 0;
+  for (unsigned int c = 0; c < Simulation_numChunks(simulation); c++) {
+    unsigned int count;
+    const char *records = Simulation_chunk(simulation, c, &count);
+    for (unsigned int i = 0; i < count; i++) {
+      const char *record = records + i * layout->stride;
+      if (*(const int *) (record + layout->kind) == SIMULATION_RETIRED_LINE) {
+        continue;
+      }
+      const double *p1 = (const double *) (record + layout->p1);
+      const double *p2 = (const double *) (record + layout->p2);
+      *x += (p1[0] + p2[0]) / 2;
+      *y += (p1[1] + p2[1]) / 2;
+      numLines++;
+    }
+  }
+  if (numLines != 0) {
+    *x /= numLines;
+    *y /= numLines;
+  }
+  return numLines;
+}
+
+static void usage(const char *program) {
+  printf("Usage: %s [-s frames per step] [-T time step] "
+         "[-k lines per node] <numFrames> <scene>\n", program);
+  exit(-1);
+}
+
+int main(int argc, char *argv[]) {
+  SimulationParams params = {0, 0};
+  unsigned int framesPerStep = 0;
+  int optchar;
+  while ((optchar = getopt(argc, argv, "s:T:k:")) != -1) {
+    switch (optchar) {
+      case 's': framesPerStep = strtoul(optarg, NULL, 10); break;
+      case 'T': params.timeStep = strtod(optarg, NULL); break;
+      case 'k': params.maxLinesPerNode = strtoul(optarg, NULL, 10); break;
+      default: usage(argv[0]);
+    }
+  }
+  if (argc - optind != 2) {
+    usage(argv[0]);
+  }
+  if (Simulation_apiVersion() != SIMULATION_API_VERSION) {
+    printf("libquadtree has API version %d, not %d\n", Simulation_apiVersion(),
+           SIMULATION_API_VERSION);
+    exit(-1);
+  }
+  const unsigned int numFrames = strtoul(argv[optind], NULL, 10);
+  if (framesPerStep == 0) {
+    framesPerStep = numFrames;
+  }
+
+  const fasttime_t loadStart = gettime();
+  Simulation *simulation = Simulation_load(argv[optind + 1], &params);
+  if (simulation == NULL) {
+    exit(-1);
+  }
+  const fasttime_t loadEnd = gettime();
+  printf("Scene load time: %fs\n", tdiff(loadStart, loadEnd));
+
+  SimulationLineLayout layout;
+  Simulation_lineLayout(&layout);
+  double stepSeconds = 0;
+  double readSeconds = 0;
+  unsigned int numLines = 0;
+  double x = 0, y = 0;
+  for (unsigned int done = 0; done < numFrames;) {
+    const unsigned int frames = numFrames - done < framesPerStep
+        ? numFrames - done : framesPerStep;
+    const fasttime_t stepStart = gettime();
+    Simulation_step(simulation, frames);
+    const fasttime_t stepEnd = gettime();
+    numLines = meanMidpoint(simulation, &layout, &x, &y);
+    readSeconds += tdiff(stepEnd, gettime());
+    stepSeconds += tdiff(stepStart, stepEnd);
+    done += frames;
+  }
+
+  SimulationStats stats;
+  Simulation_getStats(simulation, &stats);
+  printf("---- RESULTS ----\n");
+  printf("Elapsed execution time: %fs (%.1f frames/s), %fs reading lines\n",
+         stepSeconds, stepSeconds > 0 ? stats.frames / stepSeconds : 0.0,
+         readSeconds);
+  printf("%u Line-Wall Collisions\n", stats.lineWallCollisions);
+  printf("%u Line-Line Collisions\n", stats.lineLineCollisions);
+  printf("%" PRIu64 " intersect() calls, %" PRIu64
+         " avoided by pair certificates\n",
+         stats.narrowPhaseTests, stats.narrowPhaseSkips);
+  printf("%" PRIu64 " pairs rejected by the box prefilter, %" PRIu64
+         " intersection events\n",
+         stats.boxRejects, stats.events);
+  printf("%u lines (%u awake), mean midpoint (%.9f, %.9f)\n", numLines,
+         stats.numActiveLines, x, y);
+  printf("---- END RESULTS ----\n");
+
+  Simulation_delete(simulation);
+  return 0;
+}
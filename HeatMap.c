@@ -0,0 +1,191 @@
+/*
+ * HeatMap.c -- where in the box traverseQuadtree spends its work
+ */
+
+#include "./HeatMap.h"
+
+#ifdef HEAT_MAP
+
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+  Node *node;
+  unsigned int level;
+} HeatMapRow;
+
+typedef struct {
+  HeatMapRow *rows;
+  unsigned int numRows;
+  unsigned int capacity;
+} HeatMapRows;
+
+bool heatMapping = false;
+
+// Appends every node under node that ever held lines.
+static void collectRows(HeatMapRows *rows, Node *node, unsigned int level) {
+  if (node->frames != 0) {
+    if (rows->numRows == rows->capacity) {
+      rows->capacity = rows->capacity ? 2 * rows->capacity : 256;
+      rows->rows = realloc(rows->rows, rows->capacity * sizeof(HeatMapRow));
+    }
+    rows->rows[rows->numRows].node = node;
+    rows->rows[rows->numRows].level = level;
+    rows->numRows++;
+  }
+  if (node->nw != NULL) {
+    collectRows(rows, node->nw, level + 1);
+    collectRows(rows, node->ne, level + 1);
+    collectRows(rows, node->sw, level + 1);
+    collectRows(rows, node->se, level + 1);
+  }
+}
+
+// Hottest first; ties in level order, then by position, so the table is
+// the same from run to run.
+static int compareRows(const void *a, const void *b) {
+  const HeatMapRow *x = a;
+  const HeatMapRow *y = b;
+  if (x->node->seconds != y->node->seconds) {
+    return x->node->seconds < y->node->seconds ? 1 : -1;
+  }
+  if (x->level != y->level) {
+    return x->level < y->level ? -1 : 1;
+  }
+  if (x->node->yMin != y->node->yMin) {
+    return x->node->yMin < y->node->yMin ? -1 : 1;
+  }
+  return (x->node->xMin > y->node->xMin) - (x->node->xMin < y->node->xMin);
+}
+
+static bool writeTable(HeatMapRows *rows, const char *path) {
+  FILE *file = fopen(path, "w");
+  if (file == NULL) {
+    perror(path);
+    return false;
+  }
+  fprintf(file, "level\txMin\txMax\tyMin\tyMax\tframes\tmeanLines"
+          "\tpairTests\tnarrowPhaseTests\tseconds\n");
+  for (unsigned int i = 0; i < rows->numRows; i++) {
+    Node *node = rows->rows[i].node;
+    fprintf(file, "%u\t%.9g\t%.9g\t%.9g\t%.9g\t%u\t%.2f\t%" PRIu64 "\t%"
+            PRIu64 "\t%.9f\n",
+            rows->rows[i].level, node->xMin, node->xMax, node->yMin,
+            node->yMax, node->frames,
+            (double) node->lineFrames / node->frames, node->pairTests,
+            node->narrowPhaseTests, node->seconds);
+  }
+  bool ok = !ferror(file);
+  if (fclose(file) != 0) {
+    ok = false;
+  }
+  if (!ok) {
+    perror(path);
+  }
+  return ok;
+}
+
+// Spreads each node's time evenly over its area, in window pixels.  A node
+// only partly covering a pixel gives it that part of its density, so the
+// image's total is the total time however deep the nodes go.
+static void rasterize(HeatMapRows *rows, double *pixels) {
+  for (unsigned int i = 0; i < rows->numRows; i++) {
+    Node *node = rows->rows[i].node;
+    window_dimension x0, y0, x1, y1;
+    boxToWindow(&x0, &y0, node->xMin, node->yMin);
+    boxToWindow(&x1, &y1, node->xMax, node->yMax);
+    const double density = node->seconds / ((x1 - x0) * (y1 - y0));
+    const int pxMin = fmax(floor(x0), 0);
+    const int pxMax = fmin(ceil(x1), WINDOW_WIDTH);
+    const int pyMin = fmax(floor(y0), 0);
+    const int pyMax = fmin(ceil(y1), WINDOW_HEIGHT);
+    for (int py = pyMin; py < pyMax; py++) {
+      const double coverY = fmin(y1, py + 1) - fmax(y0, py);
+      for (int px = pxMin; px < pxMax; px++) {
+        const double coverX = fmin(x1, px + 1) - fmax(x0, px);
+        pixels[py * WINDOW_WIDTH + px] += density * coverX * coverY;
+      }
+    }
+  }
+}
+
+// Black through red and yellow to white as t goes from 0 to 1.
+static void heatColour(double t, unsigned char *rgb) {
+  t = fmin(fmax(t, 0), 1);
+  rgb[0] = 255 * fmin(3 * t, 1);
+  rgb[1] = 255 * fmin(fmax(3 * t - 1, 0), 1);
+  rgb[2] = 255 * fmin(fmax(3 * t - 2, 0), 1);
+}
+
+static bool writeImage(HeatMapRows *rows, const char *path) {
+  double *pixels = calloc(WINDOW_WIDTH * WINDOW_HEIGHT, sizeof(double));
+  rasterize(rows, pixels);
+  double hottest = 0;
+  for (int i = 0; i < WINDOW_WIDTH * WINDOW_HEIGHT; i++) {
+    hottest = fmax(hottest, pixels[i]);
+  }
+
+  FILE *file = fopen(path, "wb");
+  if (file == NULL) {
+    perror(path);
+    free(pixels);
+    return false;
+  }
+  fprintf(file, "P6\n%d %d\n255\n", WINDOW_WIDTH, WINDOW_HEIGHT);
+  unsigned char *row = malloc(3 * WINDOW_WIDTH);
+  for (int py = 0; py < WINDOW_HEIGHT; py++) {
+    for (int px = 0; px < WINDOW_WIDTH; px++) {
+      const double cost = pixels[py * WINDOW_WIDTH + px];
+      const double t = cost > 0 ? 1 + log10(cost / hottest) / HEAT_MAP_DECADES
+          : 0;
+      heatColour(t, &row[3 * px]);
+    }
+    fwrite(row, 3, WINDOW_WIDTH, file);
+  }
+  free(row);
+  free(pixels);
+
+  bool ok = !ferror(file);
+  if (fclose(file) != 0) {
+    ok = false;
+  }
+  if (!ok) {
+    perror(path);
+  }
+  return ok;
+}
+
+bool HeatMap_write(Node *root, const char *prefix) {
+  HeatMapRows rows = {NULL, 0, 0};
+  collectRows(&rows, root, 0);
+  qsort(rows.rows, rows.numRows, sizeof(HeatMapRow), compareRows);
+
+  uint64_t pairTests = 0, narrowPhaseTests = 0;
+  double seconds = 0;
+  for (unsigned int i = 0; i < rows.numRows; i++) {
+    pairTests += rows.rows[i].node->pairTests;
+    narrowPhaseTests += rows.rows[i].node->narrowPhaseTests;
+    seconds += rows.rows[i].node->seconds;
+  }
+
+  const size_t length = strlen(prefix);
+  char *path = malloc(length + sizeof(".ppm"));
+  memcpy(path, prefix, length);
+  strcpy(path + length, ".tsv");
+  bool ok = writeTable(&rows, path);
+  strcpy(path + length, ".ppm");
+  ok = writeImage(&rows, path) && ok;
+
+  printf("Heat map: %u nodes, %" PRIu64 " pair tests, %" PRIu64
+         " intersect() calls, %fs in node line tests, written to %s.tsv "
+         "and %s.ppm\n",
+         rows.numRows, pairTests, narrowPhaseTests, seconds, prefix, prefix);
+  free(path);
+  free(rows.rows);
+  return ok;
+}
+
+#endif  // HEAT_MAP
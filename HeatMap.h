@@ -0,0 +1,91 @@
+/*
+ * HeatMap.h -- where in the box traverseQuadtree spends its work
+ *
+ * Built only when HEAT_MAP is defined ("make HEAT_MAP=1"), and then only
+ * counts while heatMapping is set.  Every quadtree node accumulates, over
+ * the run, the candidate pairs its own lines took part in, the intersect()
+ * calls among them, and the time spent testing them (its children's time
+ * is their own).  HeatMap_write turns the totals into a per-node table and
+ * a picture of the box, without going near the X11 code.
+ *
+ * Without HEAT_MAP the macros expand to nothing and nodes carry no
+ * counters.  With it but not enabled, each macro costs one predictable
+ * branch.
+ */
+
+#ifndef HEATMAP_H_
+#define HEATMAP_H_
+
+#include <stdbool.h>
+
+#ifdef HEAT_MAP
+
+#include "./fasttime.h"
+#include "./Quadtree.h"
+
+// Decades of cost below the hottest pixel that still get a colour.
+#define HEAT_MAP_DECADES 4
+
+// Whether traverseQuadtree charges its work to the nodes.
+extern bool heatMapping;
+
+// The event list counts at the start of a node's line tests.
+typedef struct {
+  fasttime_t start;
+  uint64_t pairTests;
+  uint64_t narrowPhaseTests;
+} HeatMapSample;
+
+static inline uint64_t HeatMap_pairTests(
+    const IntersectionEventList *events) {
+  return events->boxRejects + events->narrowPhaseTests
+      + events->narrowPhaseSkips;
+}
+
+static inline void HeatMap_begin(HeatMapSample *sample,
+                                 const IntersectionEventList *events) {
+  sample->pairTests = HeatMap_pairTests(events);
+  sample->narrowPhaseTests = events->narrowPhaseTests;
+  sample->start = gettime();
+}
+
+// Charge node with the work done since HeatMap_begin.  events must be the
+// same view; there may be no spawn in between.
+static inline void HeatMap_charge(Node *node, const HeatMapSample *sample,
+                                  const IntersectionEventList *events) {
+  node->seconds += tdiff(sample->start, gettime());
+  node->pairTests += HeatMap_pairTests(events) - sample->pairTests;
+  node->narrowPhaseTests += events->narrowPhaseTests
+      - sample->narrowPhaseTests;
+  node->lineFrames += node->numberOfLines;
+  node->frames++;
+}
+
+// Write the totals of the tree under root as prefix.ppm, a WINDOW_WIDTH by
+// WINDOW_HEIGHT image of traverseQuadtree time per unit of box area on a
+// log scale (black is cold, white the hottest), and prefix.tsv, one row per
+// node that ever held lines, hottest first.  Returns false, after printing
+// why, if either can't be written.
+bool HeatMap_write(Node *root, const char *prefix);
+
+#define HEAT_MAP_BEGIN(events) \
+  HeatMapSample heatMapSample = {0}; \
+  if (heatMapping) { \
+    HeatMap_begin(&heatMapSample, events); \
+  }
+
+#define HEAT_MAP_END(node, events) \
+  do { \
+    if (heatMapping) { \
+      HeatMap_charge(node, &heatMapSample, events); \
+    } \
+  } while (0)
+
+#else
+
+#define HEAT_MAP_BEGIN(events)
+#define HEAT_MAP_END(node, events)
+
+#endif  // HEAT_MAP
+
+#endif  // HEATMAP_H_
@@ -99,6 +99,57 @@ IntersectionType intersect(Line *l1, Line *l2, double time) {
     return L1_WITH_L2;
 }
 
+// Cap on framesToContact, used for lines with no relative motion.
+#define FRAMES_TO_CONTACT_MAX (1 << 20)
+
+// intersect() can only report a pair whose distance is at most their
+// relative displacement over one time step, and the distance shrinks by
+// at most that much per step.
+unsigned int framesToContact(Line *l1, Line *l2, double time) {
+  double distance = segmentDistance(l1->p1, l1->p2, l2->p1, l2->p2);
+  double vx = l1->velocity.x - l2->velocity.x;
+  double vy = l1->velocity.y - l2->velocity.y;
+  double step = time * sqrt(vx * vx + vy * vy);
+  if (step == 0) {
+    return distance > 0 ? FRAMES_TO_CONTACT_MAX : 0;
+  }
+  // keep a frame of slack for rounding in the position updates
+  double frames = floor(distance / step) - 2;
+  if (frames <= 0) {
+    return 0;
+  }
+  return frames < FRAMES_TO_CONTACT_MAX ? (unsigned int) frames
+      : FRAMES_TO_CONTACT_MAX;
+}
+
+// Squared distance from point p to the segment (p1, p2).
+static inline double pointSegmentDistanceSquared(Vec p, Vec p1, Vec p2) {
+  double sx = p2.x - p1.x;
+  double sy = p2.y - p1.y;
+  double dx = p.x - p1.x;
+  double dy = p.y - p1.y;
+  double lengthSquared = sx * sx + sy * sy;
+  double t = 0;
+  if (lengthSquared > 0) {
+    t = (dx * sx + dy * sy) / lengthSquared;
+    t = t < 0 ? 0 : (t > 1 ? 1 : t);
+  }
+  dx -= t * sx;
+  dy -= t * sy;
+  return dx * dx + dy * dy;
+}
+
+double segmentDistance(Vec p1, Vec p2, Vec p3, Vec p4) {
+  if (intersectLines(p1, p2, p3, p4)) {
+    return 0;
+  }
+  double d1 = pointSegmentDistanceSquared(p1, p3, p4);
+  double d2 = pointSegmentDistanceSquared(p2, p3, p4);
+  double d3 = pointSegmentDistanceSquared(p3, p1, p2);
+  double d4 = pointSegmentDistanceSquared(p4, p1, p2);
+  return sqrt(fmin(fmin(d1, d2), fmin(d3, d4)));
+}
+
 // Check if a point is in the parallelogram.
 bool pointInParallelogram(Vec point, Vec p1, Vec p2, Vec p3, Vec p4) {
   double d1 = direction(p1, p2, point);
@@ -37,6 +37,13 @@ typedef enum {
 // Precondition: compareLines(l1, l2) < 0 must be true.
 IntersectionType intersect(Line *l1, Line *l2, double time);
 
+// Lower bound on the number of time steps before lines l1 and l2 could be
+// reported by intersect(), assuming their velocities don't change.
+unsigned int framesToContact(Line *l1, Line *l2, double time);
+
+// Minimum distance between the segments (p1, p2) and (p3, p4).
+double segmentDistance(Vec p1, Vec p2, Vec p3, Vec p4);
+
 // Check if a point is in the parallelogram.
 bool pointInParallelogram(Vec point, Vec p1, Vec p2, Vec p3, Vec p4);
 
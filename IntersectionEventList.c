@@ -21,6 +21,7 @@
  **/
 
 #include "./IntersectionEventList.h"
+#include "./MemoryStats.h"
 
 #include <assert.h>
 #include <stdlib.h>
@@ -59,6 +60,10 @@ IntersectionEventList IntersectionEventList_make() {
   IntersectionEventList intersectionEventList;
   intersectionEventList.head = NULL;
   intersectionEventList.tail = NULL;
+  intersectionEventList.narrowPhaseTests = 0;
+  intersectionEventList.narrowPhaseSkips = 0;
+  intersectionEventList.boxRejects = 0;
+  intersectionEventList.numEvents = 0;
   return intersectionEventList;
 }
 void IntersectionEventList_appendNode(
@@ -69,6 +74,7 @@ void IntersectionEventList_appendNode(
   if (newNode == NULL) {
     return;
   }
+  MEMORY_ALLOC(MEMORY_EVENT, sizeof(IntersectionEventNode));
 
   newNode->l1 = l1;
   newNode->l2 = l2;
@@ -80,6 +86,7 @@ void IntersectionEventList_appendNode(
     intersectionEventList->tail->next = newNode;
   }
   intersectionEventList->tail = newNode;
+  intersectionEventList->numEvents++;
 }
 
 void IntersectionEventList_deleteNodes(
@@ -89,6 +96,7 @@ void IntersectionEventList_deleteNodes(
   while (curNode != NULL) {
     nextNode = curNode->next;
     free(curNode);
+    MEMORY_FREE(MEMORY_EVENT, sizeof(IntersectionEventNode));
     curNode = nextNode;
   }
   intersectionEventList->head = NULL;
@@ -96,6 +104,14 @@ void IntersectionEventList_deleteNodes(
 }
 
 void IntersectionEventList_reduce (IntersectionEventList* key, IntersectionEventList* left, IntersectionEventList* right){
+	left->narrowPhaseTests += right->narrowPhaseTests;
+	left->narrowPhaseSkips += right->narrowPhaseSkips;
+	left->boxRejects += right->boxRejects;
+	left->numEvents += right->numEvents;
+	right->narrowPhaseTests = 0;
+	right->narrowPhaseSkips = 0;
+	right->boxRejects = 0;
+	right->numEvents = 0;
 	if (left->tail == NULL) {
 		left->head = right->head;
 		left->tail = right->tail;
@@ -113,8 +129,7 @@ void IntersectionEventList_reduce (IntersectionEventList* key, IntersectionEvent
 }
 
 void IntersectionEventList_identity(IntersectionEventList* key, IntersectionEventList* value){
-	value->head = NULL;
-	value->tail = NULL;
+	*value = IntersectionEventList_make();
 }
 void IntersectionEventList_destroy(IntersectionEventList* key, IntersectionEventList* value){
 	IntersectionEventList_deleteNodes(value);
@@ -23,6 +23,8 @@
 #ifndef INTERSECTIONEVENTLIST_H_
 #define INTERSECTIONEVENTLIST_H_
 
+#include <stdint.h>
+
 #include "./Line.h"
 #include "./IntersectionDetection.h"
 #include <cilk/cilk.h>
@@ -51,6 +53,14 @@ void IntersectionEventNode_swapData(IntersectionEventNode* node1,
 struct IntersectionEventList {
   IntersectionEventNode* head;
   IntersectionEventNode* tail;
+
+  // Narrow-phase intersect() calls made, and calls avoided by pair
+  // certificates, while building this list.
+  uint64_t narrowPhaseTests;
+  uint64_t narrowPhaseSkips;
+  // Candidate pairs rejected by the swept-box prefilter, and nodes appended.
+  uint64_t boxRejects;
+  uint64_t numEvents;
 };
 typedef struct IntersectionEventList IntersectionEventList;
 
@@ -63,7 +73,7 @@ void IntersectionEventList_appendNode(
     IntersectionEventList* intersectionEventList, Line* l1, Line* l2,
     IntersectionType intersectionType);
 
-// Deletes all the nodes in the list.
+// Deletes all the nodes in the list.  The counters are left alone.
 void IntersectionEventList_deleteNodes(
     IntersectionEventList* intersectionEventList);
 
@@ -24,7 +24,9 @@
 #ifndef LINE_H_
 #define LINE_H_
 
-#include "./GraphicStuff.h"
+#include <stdbool.h>
+#include <stddef.h>
+
 #include "./Vec.h"
 
 
@@ -38,6 +40,11 @@
 #define BOX_YMIN .5
 #define BOX_YMAX 1
 
+// Lines slower than SLEEP_SPEED (box units per time step) for SLEEP_FRAMES
+// consecutive frames are put to sleep until something touches them.
+#define SLEEP_SPEED 1e-9
+#define SLEEP_FRAMES 32
+
 // Graphics are displayed in a box of this size.
 #define WINDOW_WIDTH 1180
 #define WINDOW_HEIGHT 800
@@ -51,6 +58,30 @@ typedef enum {
   GRAY = 1
 } Color;
 
+// Dynamic lines move and collide; static lines are fixed obstacles with
+// infinite mass that live in a separate, immutable spatial index.  Retired
+// lines are the storage of removed lines, waiting to be reused.
+typedef enum {
+  DYNAMIC_LINE = 0,
+  STATIC_LINE = 1,
+  RETIRED_LINE = 2
+} LineKind;
+
+// Number of pair certificates each line caches, indexed by the other
+// line's id.  Must be a power of two.
+#define PAIR_CERTIFICATE_SLOTS 4
+
+// A lower bound on when a pair of lines could next touch.  The pair is
+// skipped by the narrow phase until the frame after expires, or until
+// either line's velocity changes.  The other line is named by id, which a
+// reinserted line keeps while its velocity version moves on.  A slot whose
+// otherVelocityVersion is 0 is empty, since every line's is at least 1.
+struct PairCertificate {
+  unsigned int otherId;
+  unsigned int otherVelocityVersion;  // other->velocityVersion when computed
+  unsigned int expires;
+};
+typedef struct PairCertificate PairCertificate;
 
 // A two-dimensional line.
 struct Line {
@@ -60,20 +91,12 @@ struct Line {
   Vec fut_p1; //one endpoint after timestep
   Vec fut_p2; //other endpoint after timestep
 
-  Vec * maxXpointer;
-  Vec * minXpointer;
-  Vec * maxYpointer;
-  Vec * minYpointer;
-
-  Vec * currentYmax;
-  Vec * currentYmin;
-  Vec * currentXmax;
-  Vec * currentXmin;
-
-  Vec * futureYmax;
-  Vec * futureYmin;
-  Vec * futureXmax;
-  Vec * futureXmin;
+  // Bounding box of the parallelogram swept by the line between now and
+  // the next time step.
+  double sweptXmin;
+  double sweptXmax;
+  double sweptYmin;
+  double sweptYmax;
 
   double length;
 
@@ -82,7 +105,29 @@ struct Line {
 
   Color color;  // The line's color.
 
+  LineKind kind;  // Whether the line moves or is fixed geometry.
+
+  // Number of upcoming frames during which the line provably stays in its
+  // quadtree node; updateNode skips it while this is nonzero.
+  unsigned int nodeCertificate;
+
+  // Bumped on every velocity change; invalidates other lines' pair
+  // certificates involving this line.
+  unsigned int velocityVersion;
+  PairCertificate pairCertificates[PAIR_CERTIFICATE_SLOTS];
+
+  // Sleeping lines skip position updates and re-placement in the quadtree.
+  bool asleep;
+  unsigned int restFrames;  // Consecutive frames spent below SLEEP_SPEED.
+
   unsigned int id;  // Unique line ID.
+
+  unsigned int index;  // Position in the CollisionWorld's lines array.
+
+  // The quadtree node whose list (or buffer) holds the line, and the line's
+  // entry there, kept up to date by the functions that add it to a list.
+  struct quadtree_node *quadtreeNode;
+  struct LinkedLineNode *quadtreeLineNode;
 };
 typedef struct Line Line;
 
@@ -99,35 +144,119 @@ static inline int compareLines(Line *line1, Line *line2) {
   return 1;
 }
 
-//Call this when ever the velocity of a line updates
-static inline void updateLineFuturePoints(Line *line){
+// Branch-free min/max; these compile to minsd/maxsd.
+static inline double minDouble(double a, double b) {
+  return a < b ? a : b;
+}
+
+static inline double maxDouble(double a, double b) {
+  return a > b ? a : b;
+}
 
-	line->fut_p1.x = line->p1.x + globalTimeStep * line->velocity.x;
-	line->fut_p1.y = line->p1.y + globalTimeStep * line->velocity.y;
-	line->fut_p2.x = line->p2.x + globalTimeStep * line->velocity.x;
-	line->fut_p2.y = line->p2.y + globalTimeStep * line->velocity.y;
+// Recompute the swept box from the current and future endpoints.
+static inline void updateLineSweptBox(Line *line) {
+	line->sweptXmin = minDouble(minDouble(line->p1.x, line->p2.x),
+			minDouble(line->fut_p1.x, line->fut_p2.x));
+	line->sweptXmax = maxDouble(maxDouble(line->p1.x, line->p2.x),
+			maxDouble(line->fut_p1.x, line->fut_p2.x));
+	line->sweptYmin = minDouble(minDouble(line->p1.y, line->p2.y),
+			minDouble(line->fut_p1.y, line->fut_p2.y));
+	line->sweptYmax = maxDouble(maxDouble(line->p1.y, line->p2.y),
+			maxDouble(line->fut_p1.y, line->fut_p2.y));
+}
 
-	if(line->velocity.x > 0){
+// Compute the endpoints after one time step, and the swept box.
+static inline void computeLineFuturePoints(Line *line, double timeStep) {
+	line->fut_p1.x = line->p1.x + timeStep * line->velocity.x;
+	line->fut_p1.y = line->p1.y + timeStep * line->velocity.y;
+	line->fut_p2.x = line->p2.x + timeStep * line->velocity.x;
+	line->fut_p2.y = line->p2.y + timeStep * line->velocity.y;
 
-		line->maxXpointer = line->futureXmax;
-		line->minXpointer = line->currentXmin;
-	}
-	else{
+	updateLineSweptBox(line);
+}
+
+//Call this when ever the velocity of a line updates
+static inline void updateLineFuturePoints(Line *line, double timeStep){
+	computeLineFuturePoints(line, timeStep);
 
-		line->maxXpointer = line->currentXmax;
-		line->minXpointer = line->futureXmin;
+	// the certificates assumed the old velocity
+	line->nodeCertificate = 0;
+	line->velocityVersion++;
+	for (int i = 0; i < PAIR_CERTIFICATE_SLOTS; i++) {
+		line->pairCertificates[i].otherVelocityVersion = 0;
 	}
+}
+
+// Move the line to its future position and compute the next one.
+static inline void advanceLine(Line *line, double timeStep) {
+	line->p1 = line->fut_p1;
+	line->p2 = line->fut_p2;
+	computeLineFuturePoints(line, timeStep);
+}
 
-	if(line->velocity.y > 0){
+// Wake the line up; called whenever a collision touches it.
+static inline void wakeLine(Line *line) {
+	line->asleep = false;
+	line->restFrames = 0;
+}
 
-		line->maxYpointer = line->futureYmax;
-		line->minYpointer = line->currentYmin;
+// Count the frames the line has spent at rest.  Once it has been at rest
+// for SLEEP_FRAMES frames well inside the box it goes to sleep.
+// Returns whether the line is still awake.
+static inline bool updateLineSleepState(Line *line, double timeStep) {
+	double speedSquared = line->velocity.x * line->velocity.x
+			+ line->velocity.y * line->velocity.y;
+	if (speedSquared >= SLEEP_SPEED * SLEEP_SPEED) {
+		line->restFrames = 0;
+		return true;
 	}
+	line->restFrames++;
+	if (line->restFrames >= SLEEP_FRAMES
+			&& line->sweptXmin > BOX_XMIN && line->sweptXmax < BOX_XMAX
+			&& line->sweptYmin > BOX_YMIN && line->sweptYmax < BOX_YMAX) {
+		line->asleep = true;
+		line->velocity.x = 0;
+		line->velocity.y = 0;
+		updateLineFuturePoints(line, timeStep);
+		return false;
+	}
+	return true;
+}
+
+// Initialize a line from its box-coordinate endpoints and velocity, for a
+// world simulated at timeStep.
+static inline void initLine(Line *line, Vec p1, Vec p2, Vec velocity,
+                            Color color, LineKind kind, unsigned int id,
+                            double timeStep) {
+	line->p1 = p1;
+	line->p2 = p2;
+	line->kind = kind;
 
-	else{
-		line->maxYpointer = line->currentYmax;
-		line->minYpointer = line->futureYmin;
+	// static lines never move
+	if (kind == STATIC_LINE) {
+		velocity.x = 0;
+		velocity.y = 0;
 	}
+	line->velocity = velocity;
+
+	//set fut_p1, fut_p2 and the swept box, and clear the certificates
+	line->velocityVersion = 0;
+	updateLineFuturePoints(line, timeStep);
+
+	line->color = color;
+
+	// every line starts awake
+	line->asleep = false;
+	line->restFrames = 0;
+
+	//calculate the length of the vector when we start because that does not change
+	line->length = Vec_length(Vec_subtract(line->p1, line->p2));
+
+	line->id = id;
+
+	// placed by the quadtree
+	line->quadtreeNode = NULL;
+	line->quadtreeLineNode = NULL;
 }
 
 // Convert graphical window coordinates to box coordinates.
@@ -28,9 +28,10 @@
 #include <assert.h>
 #include <stdio.h>
 
-#include "./GraphicStuff.h"
 #include "./Line.h"
 #include "./Quadtree.h"
+#include "./SceneFile.h"
+#include "./SceneParser.h"
 #include "./Vec.h"
 
 
@@ -58,120 +59,19 @@ void LineDemo_delete(LineDemo* lineDemo) {
 }
 
 // Read in lines from line.in and add them into collision world for simulation.
+// Each record is "(x1, y1), (x2, y2), vx, vy, isGray" with an optional
+// trailing ", isStatic" marking fixed geometry.  Binary scenes written by
+// SceneConvert are mapped instead.
 void LineDemo_createLines(LineDemo* lineDemo) {
-  unsigned int lineId = 0;
-  unsigned int numOfLines;
-  window_dimension px1;
-  window_dimension py1;
-  window_dimension px2;
-  window_dimension py2;
-  window_dimension vx;
-  window_dimension vy;
-  int isGray;
-  FILE *fin;
-  fin = fopen(LineDemo_input_file_path, "r");
-  assert(fin != NULL);
-
-  fscanf(fin, "%d\n", &numOfLines);
-  lineDemo->collisionWorld = CollisionWorld_new(numOfLines);
-
-  while (EOF
-      != fscanf(fin, "(%lf, %lf), (%lf, %lf), %lf, %lf, %d\n", &px1, &py1, &px2,
-                &py2, &vx, &vy, &isGray)) {
-    Line *line = malloc(sizeof(Line));
-
-    // convert window coordinates to box coordinates
-    windowToBox(&line->p1.x, &line->p1.y, px1, py1);
-    windowToBox(&line->p2.x, &line->p2.y, px2, py2);
-
-    // convert window velocity to box velocity
-    velocityWindowToBox(&line->velocity.x, &line->velocity.y, vx, vy);
-
-    //set fut_p1 and fut_p2
-	line->fut_p1.x = line->p1.x + globalTimeStep * line->velocity.x;
-	line->fut_p1.y = line->p1.y + globalTimeStep * line->velocity.y;
-	line->fut_p2.x = line->p2.x + globalTimeStep * line->velocity.x;
-	line->fut_p2.y = line->p2.y + globalTimeStep * line->velocity.y;
-
-    if(line->p1.x >= line->p2.x){
-
-		line->currentXmax = &line->p1;
-		line->currentXmin = &line->p2;
-
-		line->futureXmax = &line->fut_p1;
-		line->futureXmin = &line->fut_p2;
-
-	} else{
-		line->currentXmax = &line->p2;
-		line->currentXmin = &line->p1;
-
-		line->futureXmax = &line->fut_p2;
-		line->futureXmin = &line->fut_p1;
-    }
-
-    if(line->p1.y >= line->p2.y){
-		line->currentYmax = &line->p1;
-		line->currentYmin = &line->p2;
-
-		line->futureYmax = &line->fut_p1;
-		line->futureYmin = &line->fut_p2;
-
-	} else{
-		line->currentYmax = &line->p2;
-		line->currentYmin = &line->p1;
-
-		line->futureYmax = &line->fut_p2;
-		line->futureYmin = &line->fut_p1;
-	}
-
-	if(line->velocity.x > 0){
-
-		line->maxXpointer = line->futureXmax;
-		line->minXpointer = line->currentXmin;
-	}
-	else{
-
-		line->maxXpointer = line->currentXmax;
-		line->minXpointer = line->futureXmin;
-	}
-
-	if(line->velocity.y > 0){
-
-		line->maxYpointer = line->futureYmax;
-		line->minYpointer = line->currentYmin;
-	}
-
-	else{
-		line->maxYpointer = line->currentYmax;
-		line->minYpointer = line->futureYmin;
-	}
-
-
-//    updateLineFuturePoints(line);
-
-
-
-
-    // store color
-    line->color = (Color) isGray;
-
-
-
-
-    //initialize the line vector
-//    line->lineVec = Vec_make(line->p1.x - line->p2.x, line->p1.y - line->p2.y);
-
-    //calculate the length of the vector when we start because that does not change
-    line->length = Vec_length(Vec_subtract(line->p1, line->p2));
-
-    // store line ID
-    line->id = lineId;
-    lineId++;
-
-    // transfer ownership of line to collisionWorld
-    CollisionWorld_addLine(lineDemo->collisionWorld, line);
+  if (SceneFile_isBinary(LineDemo_input_file_path)) {
+    lineDemo->collisionWorld = SceneFile_load(LineDemo_input_file_path);
+  } else {
+    lineDemo->collisionWorld = SceneParser_load(LineDemo_input_file_path);
+  }
+  // the loaders have said why
+  if (lineDemo->collisionWorld == NULL) {
+    exit(-1);
   }
-  fclose(fin);
 }
 
 void LineDemo_setNumFrames(LineDemo* lineDemo, const unsigned int numFrames) {
@@ -0,0 +1,165 @@
+/*
+ * MemoryStats.c -- memory footprint and allocation counts of the simulation
+ */
+
+#include "./MemoryStats.h"
+
+#ifdef MEMORY_STATS
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "./Quadtree.h"
+
+static const char *siteNames[NUM_MEMORY_SITES] = {
+  "create_node",
+  "createLineNode",
+  "updateNode sentinel",
+  "IntersectionEventList_appendNode"
+};
+
+MemorySiteCounts memorySites[NUM_MEMORY_SITES];
+bool memoryPeakTracking = false;
+unsigned long long memoryLiveBytes;
+unsigned long long memoryPeakBytes;
+
+// The world whose frames are counted, set by MemoryStats_startFrames.
+static CollisionWorld *countedWorld;
+
+// Per-frame allocations and frees at each site, and the counts at the end
+// of the last frame.
+static unsigned int numFrames;
+static unsigned long long lastAllocs[NUM_MEMORY_SITES];
+static unsigned long long lastFrees[NUM_MEMORY_SITES];
+static unsigned long long frameAllocs[NUM_MEMORY_SITES];
+static unsigned long long frameFrees[NUM_MEMORY_SITES];
+static unsigned long long maxFrameAllocs[NUM_MEMORY_SITES];
+static unsigned long long maxFrameFrees[NUM_MEMORY_SITES];
+
+static unsigned long long liveCount(MemorySite site) {
+  return memorySites[site].allocs - memorySites[site].frees;
+}
+
+static unsigned long long liveBytes(MemorySite site) {
+  return memorySites[site].bytesAllocated - memorySites[site].bytesFreed;
+}
+
+void MemoryStats_trackPeak() {
+  unsigned long long live = 0;
+  for (int site = 0; site < NUM_MEMORY_SITES; site++) {
+    live += liveBytes(site);
+  }
+  memoryLiveBytes = live;
+  memoryPeakBytes = live;
+  memoryPeakTracking = true;
+}
+
+void MemoryStats_startFrames(CollisionWorld* collisionWorld) {
+  for (int site = 0; site < NUM_MEMORY_SITES; site++) {
+    lastAllocs[site] = memorySites[site].allocs;
+    lastFrees[site] = memorySites[site].frees;
+  }
+  __atomic_store_n(&countedWorld, collisionWorld, __ATOMIC_RELEASE);
+}
+
+void MemoryStats_beginFrame(CollisionWorld* collisionWorld) {
+  CollisionWorld *counted = __atomic_load_n(&countedWorld, __ATOMIC_ACQUIRE);
+  if (counted != NULL && counted != collisionWorld) {
+    fprintf(stderr, "MEMORY_STATS counts the frames of one world, and "
+            "another world was stepped while they were counted\n");
+    exit(-1);
+  }
+}
+
+void MemoryStats_endFrame(CollisionWorld* collisionWorld) {
+  if (collisionWorld != __atomic_load_n(&countedWorld, __ATOMIC_ACQUIRE)) {
+    return;
+  }
+  for (int site = 0; site < NUM_MEMORY_SITES; site++) {
+    const unsigned long long allocs = memorySites[site].allocs
+        - lastAllocs[site];
+    const unsigned long long frees = memorySites[site].frees
+        - lastFrees[site];
+    frameAllocs[site] += allocs;
+    frameFrees[site] += frees;
+    if (allocs > maxFrameAllocs[site]) {
+      maxFrameAllocs[site] = allocs;
+    }
+    if (frees > maxFrameFrees[site]) {
+      maxFrameFrees[site] = frees;
+    }
+    lastAllocs[site] = memorySites[site].allocs;
+    lastFrees[site] = memorySites[site].frees;
+  }
+  numFrames++;
+}
+
+size_t MemoryStats_lineStorageBytes(CollisionWorld* collisionWorld) {
+  size_t bytes = collisionWorld->maxChunks * sizeof(LineChunk)
+      + collisionWorld->capacity * sizeof(Line*)
+      + collisionWorld->staticCapacity * sizeof(Line*);
+  for (unsigned int i = 0; i < collisionWorld->numOfChunks; i++) {
+    bytes += collisionWorld->chunks[i].capacity * sizeof(Line);
+  }
+  // the retired lines grow at powers of two
+  size_t retiredCapacity = 0;
+  if (collisionWorld->numOfRetiredLines != 0) {
+    retiredCapacity = 1;
+    while (retiredCapacity < collisionWorld->numOfRetiredLines) {
+      retiredCapacity *= 2;
+    }
+  }
+  return bytes + retiredCapacity * sizeof(Line*);
+}
+
+void MemoryStats_print(CollisionWorld* collisionWorld) {
+  printf("---- MEMORY (bytes asked of malloc) ----\n");
+  printf("%-34s %12s %12s %10s %12s %20s %20s\n", "site", "allocs", "frees",
+         "live", "live bytes", "allocs/frame (max)", "frees/frame (max)");
+  for (int site = 0; site < NUM_MEMORY_SITES; site++) {
+    const double frames = numFrames ? numFrames : 1;
+    printf("%-34s %12llu %12llu %10llu %12llu %10.1f (%7llu) %10.1f (%7llu)\n",
+           siteNames[site], memorySites[site].allocs, memorySites[site].frees,
+           liveCount(site), liveBytes(site), frameAllocs[site] / frames,
+           maxFrameAllocs[site], frameFrees[site] / frames,
+           maxFrameFrees[site]);
+  }
+
+  const unsigned int numOfLines = collisionWorld->numOfLines;
+  const size_t lineBytes = MemoryStats_lineStorageBytes(collisionWorld);
+  const unsigned long long nodes = liveCount(MEMORY_NODE);
+  const unsigned long long treeBytes = liveBytes(MEMORY_NODE);
+  const unsigned long long lineNodes = liveCount(MEMORY_LINE_NODE)
+      + liveCount(MEMORY_SENTINEL);
+  const unsigned long long lineNodeBytes = liveBytes(MEMORY_LINE_NODE)
+      + liveBytes(MEMORY_SENTINEL);
+  const unsigned long long eventBytes = liveBytes(MEMORY_EVENT);
+  const unsigned long long totalBytes = lineBytes + treeBytes + lineNodeBytes
+      + eventBytes;
+  printf("Live memory by subsystem:\n");
+  printf("  lines        %12zu bytes (%u lines of %zu bytes, with room for "
+         "more)\n", lineBytes, numOfLines, sizeof(Line));
+  printf("  tree         %12llu bytes (%llu nodes of %zu bytes)\n", treeBytes,
+         nodes, sizeof(Node));
+  printf("  line nodes   %12llu bytes (%llu line nodes of %zu bytes)\n",
+         lineNodeBytes, lineNodes, sizeof(LineNode));
+  printf("  event lists  %12llu bytes (%llu events of %zu bytes)\n",
+         eventBytes, liveCount(MEMORY_EVENT), sizeof(IntersectionEventNode));
+  printf("  total        %12llu bytes\n", totalBytes);
+  if (numOfLines != 0) {
+    printf("Per line: %.1f bytes of line storage, %.1f bytes in all\n",
+           (double) lineBytes / numOfLines, (double) totalBytes / numOfLines);
+  }
+  if (nodes != 0) {
+    printf("Per tree node: %zu bytes, %.1f with its line nodes\n",
+           sizeof(Node), (double) (treeBytes + lineNodeBytes) / nodes);
+  }
+  if (memoryPeakTracking) {
+    // the line storage only grows, so it was never larger than now
+    printf("Peak: %llu bytes (%llu at the counted sites, plus the line "
+           "storage)\n", memoryPeakBytes + lineBytes, memoryPeakBytes);
+  }
+  printf("---- END MEMORY ----\n");
+}
+
+#endif  // MEMORY_STATS
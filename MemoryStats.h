@@ -0,0 +1,120 @@
+/*
+ * MemoryStats.h -- memory footprint and allocation counts of the simulation
+ *
+ * Built only when MEMORY_STATS is defined ("make MEMORY_STATS=1").  Each
+ * allocation site that runs during the frames counts its allocations,
+ * frees and bytes with relaxed atomics, so parallel tasks can count
+ * without locks.  MemoryStats_print then reports the live memory by
+ * subsystem, what a line and a quadtree node cost, and the allocations and
+ * frees per frame at each site.  The line storage isn't counted as it
+ * changes; it only grows, and is measured from the CollisionWorld when
+ * reporting.
+ *
+ * Byte counts are what was asked of malloc, without its own overhead.
+ *
+ * The site counts are process-wide, so the frames of only one world are
+ * counted, and stepping another world while they are being counted is
+ * refused.
+ *
+ * Without MEMORY_STATS the macros expand to nothing.
+ */
+
+#ifndef MEMORYSTATS_H_
+#define MEMORYSTATS_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef MEMORY_STATS
+
+#include "./CollisionWorld.h"
+
+typedef enum {
+  MEMORY_NODE,        // create_node
+  MEMORY_LINE_NODE,   // createLineNode
+  MEMORY_SENTINEL,    // updateNode's sentinel line node
+  MEMORY_EVENT,       // IntersectionEventList_appendNode
+  NUM_MEMORY_SITES
+} MemorySite;
+
+// One site's counts since the start.  Padded so that sites counted by
+// different tasks don't share a cache line.
+typedef struct {
+  unsigned long long allocs;
+  unsigned long long frees;
+  unsigned long long bytesAllocated;
+  unsigned long long bytesFreed;
+  char padding[32];
+} MemorySiteCounts;
+
+extern MemorySiteCounts memorySites[NUM_MEMORY_SITES];
+
+// Whether allocations also track the high-water mark of the live bytes.
+extern bool memoryPeakTracking;
+extern unsigned long long memoryLiveBytes;
+extern unsigned long long memoryPeakBytes;
+
+// Start tracking the high-water mark, from the bytes live now.
+void MemoryStats_trackPeak();
+
+static inline void MemoryStats_alloc(MemorySite site, size_t bytes) {
+  __atomic_fetch_add(&memorySites[site].allocs, 1, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&memorySites[site].bytesAllocated, bytes,
+                     __ATOMIC_RELAXED);
+  if (memoryPeakTracking) {
+    unsigned long long live = __atomic_add_fetch(&memoryLiveBytes, bytes,
+                                                 __ATOMIC_RELAXED);
+    unsigned long long peak = __atomic_load_n(&memoryPeakBytes,
+                                              __ATOMIC_RELAXED);
+    while (live > peak
+           && !__atomic_compare_exchange_n(&memoryPeakBytes, &peak, live,
+                                           true, __ATOMIC_RELAXED,
+                                           __ATOMIC_RELAXED)) {
+    }
+  }
+}
+
+static inline void MemoryStats_free(MemorySite site, size_t bytes) {
+  __atomic_fetch_add(&memorySites[site].frees, 1, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&memorySites[site].bytesFreed, bytes, __ATOMIC_RELAXED);
+  if (memoryPeakTracking) {
+    __atomic_fetch_sub(&memoryLiveBytes, bytes, __ATOMIC_RELAXED);
+  }
+}
+
+// Start counting collisionWorld's per-frame allocations from now, so that
+// loading and building the quadtrees aren't charged to the first frame.
+void MemoryStats_startFrames(CollisionWorld* collisionWorld);
+
+// Called as collisionWorld starts a frame.  Exits, after printing why, if
+// another world's frames are being counted, as its allocations would be
+// charged to that world's frames.
+void MemoryStats_beginFrame(CollisionWorld* collisionWorld);
+
+// Close the current frame's allocation counts if collisionWorld's frames
+// are being counted.  Called between frames.
+void MemoryStats_endFrame(CollisionWorld* collisionWorld);
+
+// Bytes of line storage held by collisionWorld: the lines, the chunk table,
+// and the arrays of line pointers.
+size_t MemoryStats_lineStorageBytes(CollisionWorld* collisionWorld);
+
+// Print the memory report for collisionWorld, whose quadtrees were
+// allocated through the counted sites.
+void MemoryStats_print(CollisionWorld* collisionWorld);
+
+#define MEMORY_ALLOC(site, bytes) MemoryStats_alloc(site, bytes)
+#define MEMORY_FREE(site, bytes) MemoryStats_free(site, bytes)
+#define MEMORY_BEGIN_FRAME(world) MemoryStats_beginFrame(world)
+#define MEMORY_END_FRAME(world) MemoryStats_endFrame(world)
+
+#else
+
+#define MEMORY_ALLOC(site, bytes)
+#define MEMORY_FREE(site, bytes)
+#define MEMORY_BEGIN_FRAME(world)
+#define MEMORY_END_FRAME(world)
+
+#endif  // MEMORY_STATS
+
+#endif  // MEMORYSTATS_H_
@@ -0,0 +1,744 @@
+/*
+ * Microbench.c -- microbenchmarks for the collision hot paths
+ *
+ * Times intersect(), intersectLines(), pointInParallelogram(),
+ * testNewCollisionLineNode(), mergeSort() and updateLineFuturePoints() in
+ * isolation, headless, on fixed-seed datasets of line pairs:
+ *
+ *   no-hit       pairs far apart
+ *   near-miss    parallel neighbours whose swept boxes overlap but never
+ *                touch within a time step
+ *   intersected  pairs that already cross
+ *   parallel     parallel pairs closing on each other, half of them close
+ *                enough to hit within a time step
+ *   vertical     a vertical line and a line moving across its path
+ *
+ * Every benchmark runs warmup trials, then timed trials, and reports the
+ * median and fastest trial in ns per call and ns per line pair, and how
+ * many pairs of the last trial hit.
+ *
+ * With -S, it instead loads a number of independent worlds from one scene
+ * and simulates them, first one at a time and then all at once on the
+ * shared worker pool, reporting worlds and frames per second.  With -S and
+ * -Q, it runs the scene for -f frames and then times batches of random
+ * spatial queries of each kind against brute force, checking the answers.
+ * With -S and -R, it draws that many frames of the scene offscreen with
+ * and without quadtree culling, checking the images match.  With -S and
+ * -C, it removes and reinserts lines between that many frames, checking
+ * the line set and the quadtree's lists after each.
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <cilk/cilk.h>
+#include <cilk/cilk_api.h>
+#include <cilk/reducer.h>
+
+#include "./CollisionWorld.h"
+#include "./IntersectionDetection.h"
+#include "./IntersectionEventList.h"
+#include "./Line.h"
+#include "./Quadtree.h"
+#include "./Rasterizer.h"
+#include "./SceneFile.h"
+#include "./SceneParser.h"
+#include "./SpatialQuery.h"
+#include "./fasttime.h"
+
+typedef enum {
+  NO_HIT,
+  NEAR_MISS,
+  INTERSECTED,
+  PARALLEL,
+  VERTICAL,
+  NUM_DATASETS
+} Dataset;
+
+static const char *datasetNames[NUM_DATASETS] = {
+  "no-hit", "near-miss", "intersected", "parallel", "vertical"
+};
+
+static unsigned int numPairs = 4096;
+static unsigned int warmupTrials = 3;
+static unsigned int numTrials = 21;
+
+// splitmix64
+static uint64_t randomState;
+
+static uint64_t randomNext() {
+  uint64_t z = (randomState += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+static double randomRange(double low, double high) {
+  return low + (high - low) * ((randomNext() >> 11) * 0x1.0p-53);
+}
+
+static Vec vec(double x, double y) {
+  Vec v = {x, y};
+  return v;
+}
+
+// Fills lines[2 * i] and lines[2 * i + 1] with pair i of dataset, in box
+// coordinates, with lines[2 * i] ordered first.
+static void makePairs(Dataset dataset, Line *lines) {
+  for (unsigned int i = 0; i < numPairs; i++) {
+    const double length = randomRange(0.01, 0.04);
+    const double speed = randomRange(0.0002, 0.001);
+    const double angle = randomRange(0, M_PI);
+    const Vec direction = vec(cos(angle), sin(angle));
+    const Vec normal = vec(-direction.y, direction.x);
+    const Vec center = vec(randomRange(0.6, 0.9), randomRange(0.6, 0.9));
+    Vec a1 = vec(center.x - direction.x * length / 2,
+                 center.y - direction.y * length / 2);
+    Vec a2 = vec(center.x + direction.x * length / 2,
+                 center.y + direction.y * length / 2);
+    Vec velocity1 = vec(0, 0);
+    Vec b1, b2, velocity2;
+
+    switch (dataset) {
+      case NO_HIT: {
+        double offset = randomRange(0.1, 0.2);
+        b1 = vec(a1.x + normal.x * offset, a1.y + normal.y * offset);
+        b2 = vec(a2.x + normal.x * offset, a2.y + normal.y * offset);
+        velocity1 = vec(direction.x * speed, direction.y * speed);
+        velocity2 = vec(-direction.x * speed, -direction.y * speed);
+        break;
+      }
+      case NEAR_MISS: {
+        // closing by speed per time unit, with a gap that lasts the step
+        double gap = speed * DEFAULT_TIME_STEP * randomRange(1.5, 3);
+        b1 = vec(a1.x + normal.x * gap, a1.y + normal.y * gap);
+        b2 = vec(a2.x + normal.x * gap, a2.y + normal.y * gap);
+        velocity2 = vec(-normal.x * speed, -normal.y * speed);
+        break;
+      }
+      case INTERSECTED: {
+        double crossing = randomRange(0.2, M_PI - 0.2);
+        Vec d = vec(cos(angle + crossing), sin(angle + crossing));
+        b1 = vec(center.x - d.x * length / 2, center.y - d.y * length / 2);
+        b2 = vec(center.x + d.x * length / 2, center.y + d.y * length / 2);
+        velocity2 = vec(d.x * speed, d.y * speed);
+        break;
+      }
+      case PARALLEL: {
+        double gap = speed * DEFAULT_TIME_STEP * randomRange(0.5, 1.5);
+        b1 = vec(a1.x + normal.x * gap, a1.y + normal.y * gap);
+        b2 = vec(a2.x + normal.x * gap, a2.y + normal.y * gap);
+        velocity1 = vec(normal.x * speed / 2, normal.y * speed / 2);
+        velocity2 = vec(-normal.x * speed / 2, -normal.y * speed / 2);
+        break;
+      }
+      default: {
+        a1 = vec(center.x, center.y - length / 2);
+        a2 = vec(center.x, center.y + length / 2);
+        // crosses x = center.x within one to two time steps
+        double distance = speed * DEFAULT_TIME_STEP * randomRange(0.5, 2);
+        b1 = vec(center.x - distance, center.y - length / 4);
+        b2 = vec(center.x - distance - length * direction.x,
+                 center.y - length / 4 + length * direction.y);
+        velocity2 = vec(speed, 0);
+        break;
+      }
+    }
+    initLine(&lines[2 * i], a1, a2, velocity1, RED, DYNAMIC_LINE, 2 * i,
+             DEFAULT_TIME_STEP);
+    initLine(&lines[2 * i + 1], b1, b2, velocity2, RED, DYNAMIC_LINE, 2 * i + 1,
+             DEFAULT_TIME_STEP);
+  }
+}
+
+// One trial of a benchmark over the dataset.  Returns the number of hits,
+// or NO_HITS if the benchmark doesn't test pairs.
+#define NO_HITS UINT64_MAX
+typedef uint64_t (*Body)(Line *lines, void *context);
+
+static int compareDoubles(const void *a, const void *b) {
+  double x = *(const double *) a;
+  double y = *(const double *) b;
+  return (x > y) - (x < y);
+}
+
+// Runs warmup and timed trials of body and prints one result row.
+// setup, if given, runs untimed before every trial.
+static void runBenchmark(const char *name, Dataset dataset, Body body,
+                         Body setup, Line *lines, void *context,
+                         double callsPerTrial, double pairsPerTrial) {
+  double *seconds = malloc(numTrials * sizeof(double));
+  uint64_t hits = 0;
+  for (unsigned int trial = 0; trial < warmupTrials + numTrials; trial++) {
+    if (setup != NULL) {
+      setup(lines, context);
+    }
+    const fasttime_t start = gettime();
+    hits = body(lines, context);
+    const fasttime_t end = gettime();
+    if (trial >= warmupTrials) {
+      seconds[trial - warmupTrials] = tdiff(start, end);
+    }
+  }
+  qsort(seconds, numTrials, sizeof(double), compareDoubles);
+  const double median = seconds[numTrials / 2];
+  const double fastest = seconds[0];
+  char hitsText[24] = "-";
+  if (hits != NO_HITS) {
+    snprintf(hitsText, sizeof(hitsText), "%llu", (unsigned long long) hits);
+  }
+  printf("%-30s %-12s %10.1f %10.1f %10.1f %10.1f %8s\n", name,
+         datasetNames[dataset], 1e9 * median / callsPerTrial,
+         1e9 * fastest / callsPerTrial, 1e9 * median / pairsPerTrial,
+         1e9 * fastest / pairsPerTrial, hitsText);
+  free(seconds);
+}
+
+static uint64_t benchIntersect(Line *lines, void *context) {
+  uint64_t hits = 0;
+  for (unsigned int i = 0; i < numPairs; i++) {
+    hits += intersect(&lines[2 * i], &lines[2 * i + 1], DEFAULT_TIME_STEP)
+        != NO_INTERSECTION;
+  }
+  return hits;
+}
+
+static uint64_t benchIntersectLines(Line *lines, void *context) {
+  uint64_t hits = 0;
+  for (unsigned int i = 0; i < numPairs; i++) {
+    Line *l1 = &lines[2 * i];
+    Line *l2 = &lines[2 * i + 1];
+    hits += intersectLines(l1->p1, l1->p2, l2->p1, l2->p2);
+  }
+  return hits;
+}
+
+// The parallelogram test as intersect() makes it: l1's endpoint against
+// the region l2 sweeps relative to l1.
+static uint64_t benchPointInParallelogram(Line *lines, void *context) {
+  uint64_t hits = 0;
+  for (unsigned int i = 0; i < numPairs; i++) {
+    Line *l1 = &lines[2 * i];
+    Line *l2 = &lines[2 * i + 1];
+    Vec p1 = {l2->fut_p1.x - l1->velocity.x * DEFAULT_TIME_STEP,
+              l2->fut_p1.y - l1->velocity.y * DEFAULT_TIME_STEP};
+    Vec p2 = {l2->fut_p2.x - l1->velocity.x * DEFAULT_TIME_STEP,
+              l2->fut_p2.y - l1->velocity.y * DEFAULT_TIME_STEP};
+    hits += pointInParallelogram(l1->p1, l2->p1, l2->p2, p1, p2);
+  }
+  return hits;
+}
+
+static uint64_t benchUpdateLineFuturePoints(Line *lines, void *context) {
+  for (unsigned int i = 0; i < 2 * numPairs; i++) {
+    updateLineFuturePoints(&lines[i], DEFAULT_TIME_STEP);
+  }
+  return NO_HITS;
+}
+
+// Each pair as a two-line list, its first line tested against the second
+// as traverseQuadtree does.
+typedef struct {
+  LineNode *nodes;
+  CollisionWorld *world;  // for its time step, frame and events
+  bool warm;  // keep pair certificates between trials
+} ListContext;
+
+static uint64_t setupLists(Line *lines, void *context) {
+  ListContext *lists = context;
+  IntersectionEventList_deleteNodes(&REDUCER_VIEW(lists->world->events));
+  REDUCER_VIEW(lists->world->events) = IntersectionEventList_make();
+  // expire every pair certificate unless measuring the warm path
+  if (!lists->warm) {
+    lists->world->frame += 1u << 21;
+  }
+  return 0;
+}
+
+static uint64_t benchTestNewCollisionLineNode(Line *lines, void *context) {
+  ListContext *lists = context;
+  for (unsigned int i = 0; i < numPairs; i++) {
+    testNewCollisionLineNode(&lists->nodes[2 * i], lists->world);
+  }
+  uint64_t hits = 0;
+  for (IntersectionEventNode *event = REDUCER_VIEW(lists->world->events).head;
+       event != NULL; event = event->next) {
+    hits++;
+  }
+  return hits;
+}
+
+// Event lists in a fixed shuffled order, relinked before every trial.
+typedef struct {
+  IntersectionEventNode *events;
+  unsigned int *order;
+  unsigned int numEvents;
+  IntersectionEventNode *head;
+} SortContext;
+
+static uint64_t setupSort(Line *lines, void *context) {
+  SortContext *sort = context;
+  for (unsigned int i = 0; i < sort->numEvents; i++) {
+    IntersectionEventNode *event = &sort->events[sort->order[i]];
+    event->next = i + 1 < sort->numEvents
+        ? &sort->events[sort->order[i + 1]] : NULL;
+  }
+  sort->head = &sort->events[sort->order[0]];
+  return 0;
+}
+
+static uint64_t benchMergeSort(Line *lines, void *context) {
+  SortContext *sort = context;
+  mergeSort(&sort->head);
+  return NO_HITS;
+}
+
+static CollisionWorld* loadWorld(const char *path, double timeStep) {
+  CollisionWorld *world = SceneFile_isBinary(path) ? SceneFile_load(path)
+      : SceneParser_load(path);
+  if (world == NULL) {
+    exit(-1);
+  }
+  if (timeStep != world->timeStep) {
+    CollisionWorld_setTimeStep(world, timeStep);
+  }
+  CollisionWorld_buildQuadtrees(world);
+  return world;
+}
+
+static void simulateWorld(CollisionWorld *world, unsigned int numFrames) {
+  for (unsigned int frame = 0; frame < numFrames; frame++) {
+    CollisionWorld_updateLines(world);
+  }
+}
+
+// Simulates numWorlds fresh copies of the scene at path for numFrames
+// frames each, concurrently or one after another, and prints a result row.
+// Returns false if any world's collision counts differ from the first's.
+static bool runWorlds(const char *path, unsigned int numWorlds,
+                      unsigned int numFrames, double timeStep,
+                      bool concurrent) {
+  CollisionWorld **worlds = malloc(numWorlds * sizeof(CollisionWorld*));
+  for (unsigned int w = 0; w < numWorlds; w++) {
+    worlds[w] = loadWorld(path, timeStep);
+  }
+
+  const fasttime_t start = gettime();
+  if (concurrent) {
+    cilk_for (unsigned int w = 0; w < numWorlds; w++) {
+      simulateWorld(worlds[w], numFrames);
+    }
+  } else {
+    for (unsigned int w = 0; w < numWorlds; w++) {
+      simulateWorld(worlds[w], numFrames);
+    }
+  }
+  const double seconds = tdiff(start, gettime());
+
+  // the worlds are copies, so they must all end the same way
+  bool same = true;
+  for (unsigned int w = 1; w < numWorlds; w++) {
+    same = same && worlds[w]->numLineWallCollisions
+        == worlds[0]->numLineWallCollisions
+        && worlds[w]->numLineLineCollisions
+        == worlds[0]->numLineLineCollisions;
+  }
+  printf("%-16s %10.3f %12.2f %12.1f %10u %10u%s\n",
+         concurrent ? "concurrent" : "one at a time", seconds,
+         numWorlds / seconds, (double) numWorlds * numFrames / seconds,
+         worlds[0]->numLineWallCollisions, worlds[0]->numLineLineCollisions,
+         same ? "" : "  WORLDS DIFFER");
+  for (unsigned int w = 0; w < numWorlds; w++) {
+    CollisionWorld_delete(worlds[w]);
+  }
+  free(worlds);
+  return same;
+}
+
+static const char *queryKindNames[] = {
+  "range", "segment", "radius", "nearest"
+};
+
+// Random queries of kind over the box, of a size that finds a handful of
+// lines in a dense scene.
+static void makeQueries(SpatialQueryKind kind, SpatialQuery *queries,
+                        unsigned int numQueries) {
+  for (unsigned int i = 0; i < numQueries; i++) {
+    SpatialQuery *query = &queries[i];
+    query->kind = kind;
+    query->a = vec(randomRange(BOX_XMIN, BOX_XMAX),
+                   randomRange(BOX_YMIN, BOX_YMAX));
+    const double reach = kind == QUERY_SEGMENT ? 0.1 : 0.03;
+    query->b = vec(query->a.x + randomRange(-reach, reach),
+                   query->a.y + randomRange(-reach, reach));
+    query->radius = randomRange(0, 0.015);
+    query->k = 8;
+  }
+}
+
+// Simulates the scene at path for numFrames frames, then answers
+// numQueries random queries of each kind with the quadtree and by brute
+// force.  Returns false if any answers differ.
+static bool runQueries(const char *path, unsigned int numQueries,
+                       unsigned int numFrames, double timeStep) {
+  CollisionWorld *world = loadWorld(path, timeStep);
+  simulateWorld(world, numFrames);
+  printf("%u queries of each kind on %s after %u frames, %u lines, "
+         "%d workers\n", numQueries, path, numFrames, world->numOfLines,
+         __cilkrts_get_nworkers());
+  printf("%-10s %12s %14s %14s %10s\n", "query", "matches",
+         "quadtree us/q", "brute us/q", "speedup");
+
+  SpatialQuery *queries = malloc(numQueries * sizeof(SpatialQuery));
+  bool same = true;
+  for (SpatialQueryKind kind = QUERY_RANGE; kind <= QUERY_NEAREST; kind++) {
+    makeQueries(kind, queries, numQueries);
+    SpatialQueryResults quadtree, bruteForce;
+    const fasttime_t start = gettime();
+    SpatialQuery_batch(world, queries, numQueries, &quadtree);
+    const fasttime_t middle = gettime();
+    SpatialQuery_bruteForce(world, queries, numQueries, &bruteForce);
+    const fasttime_t end = gettime();
+    const double quadtreeTime = tdiff(start, middle);
+    const double bruteForceTime = tdiff(middle, end);
+    const bool equal = SpatialQueryResults_equal(&quadtree, &bruteForce);
+    printf("%-10s %12u %14.2f %14.2f %9.1fx%s\n", queryKindNames[kind],
+           quadtree.first[numQueries], 1e6 * quadtreeTime / numQueries,
+           1e6 * bruteForceTime / numQueries,
+           quadtreeTime > 0 ? bruteForceTime / quadtreeTime : 0.0,
+           equal ? "" : "  ANSWERS DIFFER");
+    same = same && equal;
+    SpatialQueryResults_free(&quadtree);
+    SpatialQueryResults_free(&bruteForce);
+  }
+  free(queries);
+  CollisionWorld_delete(world);
+  return same;
+}
+
+// Checks the lists under node against the lines' quadtree back-pointers and
+// marks the lines found in seen, by index.  Returns the number of problems.
+static unsigned int checkQuadtreeLists(const CollisionWorld *world,
+                                       Node *node, bool *seen) {
+  if (node == NULL) {
+    return 0;
+  }
+  unsigned int problems = 0;
+  int count = 0;
+  LineNode *last = NULL;
+  for (LineNode *lineNode = node->lines; lineNode != NULL;
+       lineNode = lineNode->next) {
+    Line *line = lineNode->line;
+    if (line->kind != DYNAMIC_LINE || line->index >= world->numOfLines
+        || world->lines[line->index] != line || seen[line->index]
+        || line->quadtreeNode != node || line->quadtreeLineNode != lineNode) {
+      problems++;
+    } else {
+      seen[line->index] = true;
+    }
+    last = lineNode;
+    count++;
+  }
+  if (count != node->numberOfLines || node->firstQuadtreeLineNode != last
+      || node->bufferLineCount != 0) {
+    problems++;
+  }
+  return problems + checkQuadtreeLists(world, node->nw, seen)
+      + checkQuadtreeLists(world, node->ne, seen)
+      + checkQuadtreeLists(world, node->sw, seen)
+      + checkQuadtreeLists(world, node->se, seen);
+}
+
+// Checks that lines[] holds each live line once at its index with a unique
+// id, and that the quadtree holds every dynamic one exactly once.  Returns
+// the number of problems.
+static unsigned int checkLineSet(const CollisionWorld *world) {
+  unsigned int problems = 0;
+  bool *seen = calloc(world->numOfLines, sizeof(bool));
+  bool *ids = calloc(world->nextId, sizeof(bool));
+  for (unsigned int i = 0; i < world->numOfLines; i++) {
+    const Line *line = world->lines[i];
+    if (line->index != i || line->kind == RETIRED_LINE
+        || line->id >= world->nextId || ids[line->id]) {
+      problems++;
+      continue;
+    }
+    ids[line->id] = true;
+    // static lines are indexed separately
+    seen[i] = line->kind == STATIC_LINE;
+  }
+  problems += checkQuadtreeLists(world, world->quadtree, seen);
+  for (unsigned int i = 0; i < world->numOfLines; i++) {
+    problems += !seen[i];
+  }
+  free(ids);
+  free(seen);
+  return problems;
+}
+
+// Simulates the scene at path for numFrames frames, removing and
+// reinserting a random 1/64 of its dynamic lines between frames, and checks
+// the line set and the quadtree's lists after every frame.  Returns false
+// if any check failed.
+static bool runChurn(const char *path, unsigned int numFrames,
+                     double timeStep) {
+  CollisionWorld *world = loadWorld(path, timeStep);
+  const unsigned int churn = world->numOfLines / 64 + 1;
+  Line *removed = malloc(churn * sizeof(Line));
+  printf("%u frames of %s, %u lines, removing and reinserting %u lines "
+         "between frames\n", numFrames, path, world->numOfLines, churn);
+
+  // a pinned line set refuses changes
+  world->lineSetPins++;
+  bool pinned = CollisionWorld_insertLine(world, world->lines[0]) == NULL
+      && !CollisionWorld_removeLine(world, world->lines[0]);
+  world->lineSetPins--;
+
+  unsigned long long numRemoved = 0;
+  unsigned long long numInserted = 0;
+  double removeSeconds = 0;
+  double insertSeconds = 0;
+  unsigned int problems = checkLineSet(world);
+  for (unsigned int frame = 0; frame < numFrames && problems == 0; frame++) {
+    CollisionWorld_updateLines(world);
+
+    unsigned int numOfRemoved = 0;
+    const fasttime_t removeStart = gettime();
+    for (unsigned int i = 0; i < churn && world->numOfLines > 0; i++) {
+      Line *line = world->lines[randomNext() % world->numOfLines];
+      if (line->kind != DYNAMIC_LINE) {
+        continue;
+      }
+      removed[numOfRemoved] = *line;
+      if (!CollisionWorld_removeLine(world, line)) {
+        problems++;
+        continue;
+      }
+      numOfRemoved++;
+    }
+    const fasttime_t insertStart = gettime();
+    for (unsigned int i = 0; i < numOfRemoved; i++) {
+      problems += CollisionWorld_insertLine(world, &removed[i]) == NULL;
+    }
+    const fasttime_t insertEnd = gettime();
+    removeSeconds += tdiff(removeStart, insertStart);
+    insertSeconds += tdiff(insertStart, insertEnd);
+    numRemoved += numOfRemoved;
+    numInserted += numOfRemoved;
+
+    problems += checkLineSet(world);
+  }
+
+  printf("%llu lines removed (%.3fus each), %llu inserted (%.3fus each), "
+         "%u wall and %u line-line collisions\n", numRemoved,
+         numRemoved ? 1e6 * removeSeconds / numRemoved : 0.0, numInserted,
+         numInserted ? 1e6 * insertSeconds / numInserted : 0.0,
+         world->numLineWallCollisions, world->numLineLineCollisions);
+  if (!pinned) {
+    printf("A pinned line set accepted a change\n");
+  }
+  if (problems != 0) {
+    printf("%u PROBLEMS in the line set or the quadtree's lists\n",
+           problems);
+  }
+  free(removed);
+  CollisionWorld_delete(world);
+  return pinned && problems == 0;
+}
+
+// Simulates the scene at path, drawing each of numFrames frames with and
+// without quadtree culling, and prints the drawing rates.  Writes the frames
+// to prefixNNNNNN.ppm if prefix isn't NULL.  Returns false if any frame's
+// images differ.
+static bool runRendering(const char *path, unsigned int numFrames,
+                         double timeStep, const char *prefix) {
+  CollisionWorld *world = loadWorld(path, timeStep);
+  Rasterizer *culled = Rasterizer_new(WINDOW_WIDTH, WINDOW_HEIGHT);
+  Rasterizer *bruteForce = Rasterizer_new(WINDOW_WIDTH, WINDOW_HEIGHT);
+  char *framePath = prefix != NULL
+      ? malloc(strlen(prefix) + sizeof("000000.ppm")) : NULL;
+  printf("%u frames of %s drawn at %dx%d in %ux%u tiles, %u lines, "
+         "%d workers\n", numFrames, path, WINDOW_WIDTH, WINDOW_HEIGHT,
+         culled->numTilesX, culled->numTilesY, world->numOfLines,
+         __cilkrts_get_nworkers());
+
+  double culledTime = 0;
+  double bruteForceTime = 0;
+  unsigned int differing = 0;
+  for (unsigned int frame = 0; frame < numFrames; frame++) {
+    CollisionWorld_updateLines(world);
+    const fasttime_t start = gettime();
+    Rasterizer_draw(culled, world);
+    const fasttime_t middle = gettime();
+    Rasterizer_drawBruteForce(bruteForce, world);
+    const fasttime_t end = gettime();
+    culledTime += tdiff(start, middle);
+    bruteForceTime += tdiff(middle, end);
+    if (memcmp(culled->pixels, bruteForce->pixels,
+               3 * WINDOW_WIDTH * WINDOW_HEIGHT) != 0) {
+      differing++;
+    }
+    if (framePath != NULL) {
+      sprintf(framePath, "%s%06u.ppm", prefix, frame);
+      if (!Rasterizer_writePPM(culled, framePath)) {
+        exit(-1);
+      }
+    }
+  }
+  printf("%-12s %10s %12s\n", "tiles", "seconds", "frames/s");
+  printf("%-12s %10.4f %12.1f\n", "culled", culledTime,
+         culledTime > 0 ? numFrames / culledTime : 0.0);
+  printf("%-12s %10.4f %12.1f\n", "brute force", bruteForceTime,
+         bruteForceTime > 0 ? numFrames / bruteForceTime : 0.0);
+  if (differing != 0) {
+    printf("%u frames' images differ\n", differing);
+  }
+
+  free(framePath);
+  Rasterizer_delete(bruteForce);
+  Rasterizer_delete(culled);
+  CollisionWorld_delete(world);
+  return differing == 0;
+}
+
+static void usage(const char *program) {
+  printf("Usage: %s [-n pairs] [-w warmup trials] [-t trials] [-s seed]\n"
+         "       %s -S scene [-k worlds] [-f frames] [-T time step]\n"
+         "       %s -S scene -Q queries [-f frames] [-T time step] "
+         "[-s seed]\n"
+         "       %s -S scene -R frames [-T time step] [-o frame prefix]\n"
+         "       %s -S scene -C frames [-T time step] [-s seed]\n",
+         program, program, program, program, program);
+  exit(-1);
+}
+
+int main(int argc, char *argv[]) {
+  uint64_t seed = 1;
+  const char *scenePath = NULL;
+  unsigned int numWorlds = 16;
+  unsigned int numFrames = 100;
+  unsigned int numQueries = 0;
+  unsigned int numRendered = 0;
+  unsigned int numChurned = 0;
+  const char *framePrefix = NULL;
+  double timeStep = DEFAULT_TIME_STEP;
+  int optchar;
+  while ((optchar = getopt(argc, argv, "n:w:t:s:S:k:f:T:Q:R:o:C:")) != -1) {
+    switch (optchar) {
+      case 'n': numPairs = strtoul(optarg, NULL, 10); break;
+      case 'w': warmupTrials = strtoul(optarg, NULL, 10); break;
+      case 't': numTrials = strtoul(optarg, NULL, 10); break;
+      case 's': seed = strtoull(optarg, NULL, 10); break;
+      case 'S': scenePath = optarg; break;
+      case 'k': numWorlds = strtoul(optarg, NULL, 10); break;
+      case 'f': numFrames = strtoul(optarg, NULL, 10); break;
+      case 'T': timeStep = strtod(optarg, NULL); break;
+      case 'Q': numQueries = strtoul(optarg, NULL, 10); break;
+      case 'R': numRendered = strtoul(optarg, NULL, 10); break;
+      case 'o': framePrefix = optarg; break;
+      case 'C': numChurned = strtoul(optarg, NULL, 10); break;
+      default: usage(argv[0]);
+    }
+  }
+  if (optind != argc || numPairs == 0 || numTrials == 0 || numWorlds == 0
+      || !(timeStep > 0) || (numQueries != 0 && scenePath == NULL)
+      || (numRendered != 0 && scenePath == NULL)
+      || (numChurned != 0 && scenePath == NULL)) {
+    usage(argv[0]);
+  }
+
+  if (numQueries != 0) {
+    randomState = seed;
+    return !runQueries(scenePath, numQueries, numFrames, timeStep);
+  }
+
+  if (numChurned != 0) {
+    randomState = seed;
+    return !runChurn(scenePath, numChurned, timeStep);
+  }
+
+  if (numRendered != 0) {
+    return !runRendering(scenePath, numRendered, timeStep, framePrefix);
+  }
+
+  if (scenePath != NULL) {
+    printf("%u worlds of %s, %u frames each, time step %g, %d workers\n",
+           numWorlds, scenePath, numFrames, timeStep,
+           __cilkrts_get_nworkers());
+    printf("%-16s %10s %12s %12s %10s %10s\n", "worlds", "seconds",
+           "worlds/s", "frames/s", "wall", "line-line");
+    bool same = runWorlds(scenePath, numWorlds, numFrames, timeStep, false);
+    same = runWorlds(scenePath, numWorlds, numFrames, timeStep, true) && same;
+    return !same;
+  }
+
+  printf("%u pairs per dataset, %u warmup and %u timed trials, seed %llu\n",
+         numPairs, warmupTrials, numTrials, (unsigned long long) seed);
+  printf("%-30s %-12s %10s %10s %10s %10s %8s\n", "benchmark", "dataset",
+         "ns/call", "best", "ns/pair", "best", "hits");
+
+  // only lends testNewCollisionLineNode its time step, frame and events
+  CollisionWorld *world = CollisionWorld_new(1);
+
+  Line *lines = malloc(2 * numPairs * sizeof(Line));
+  LineNode *nodes = malloc(2 * numPairs * sizeof(LineNode));
+  IntersectionEventNode *events =
+      malloc(numPairs * sizeof(IntersectionEventNode));
+  unsigned int *order = malloc(numPairs * sizeof(unsigned int));
+
+  for (Dataset dataset = 0; dataset < NUM_DATASETS; dataset++) {
+    randomState = seed + dataset;
+    makePairs(dataset, lines);
+
+    runBenchmark("intersect", dataset, benchIntersect, NULL, lines, NULL,
+                 numPairs, numPairs);
+    runBenchmark("intersectLines", dataset, benchIntersectLines, NULL, lines,
+                 NULL, numPairs, numPairs);
+    runBenchmark("pointInParallelogram", dataset, benchPointInParallelogram,
+                 NULL, lines, NULL, numPairs, numPairs);
+
+    for (unsigned int i = 0; i < 2 * numPairs; i++) {
+      nodes[i].line = &lines[i];
+      nodes[i].next = i % 2 == 0 ? &nodes[i + 1] : NULL;
+    }
+    ListContext lists = {nodes, world, false};
+    runBenchmark("testNewCollisionLineNode", dataset,
+                 benchTestNewCollisionLineNode, setupLists, lines, &lists,
+                 numPairs, numPairs);
+    lists.warm = true;
+    runBenchmark("testNewCollisionLineNode/warm", dataset,
+                 benchTestNewCollisionLineNode, setupLists, lines, &lists,
+                 numPairs, numPairs);
+
+    // one event per pair, sorted by (l1, l2) id from a shuffled order
+    for (unsigned int i = 0; i < numPairs; i++) {
+      events[i].l1 = &lines[2 * i];
+      events[i].l2 = &lines[2 * i + 1];
+      events[i].intersectionType = L1_WITH_L2;
+      order[i] = i;
+    }
+    for (unsigned int i = numPairs - 1; i > 0; i--) {
+      unsigned int j = randomNext() % (i + 1);
+      unsigned int swap = order[i];
+      order[i] = order[j];
+      order[j] = swap;
+    }
+    SortContext sort = {events, order, numPairs, NULL};
+    runBenchmark("mergeSort", dataset, benchMergeSort, setupSort, lines, &sort,
+                 1, numPairs);
+
+    runBenchmark("updateLineFuturePoints", dataset,
+                 benchUpdateLineFuturePoints, NULL, lines, NULL,
+                 2 * numPairs, numPairs);
+  }
+
+  CollisionWorld_delete(world);
+  free(lines);
+  free(nodes);
+  free(events);
+  free(order);
+  return 0;
+}
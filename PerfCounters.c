@@ -0,0 +1,370 @@
+/*
+ * PerfCounters.c -- hardware performance counters per phase and thread
+ */
+
+#define _GNU_SOURCE
+
+#include "./PerfCounters.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef __linux__
+
+#include <dirent.h>
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+static const char *eventNames[PERF_NUM_EVENTS] = {
+  "cycles", "instructions", "L1D misses", "LLC misses", "branch misses"
+};
+
+typedef struct {
+  pid_t tid;
+  char name[16];
+  int fds[PERF_NUM_EVENTS];
+  int leader;  // fd the group is read through
+
+  // Counts at the last boundary, in group order.
+  uint64_t last[PERF_NUM_EVENTS];
+  uint64_t lastEnabled;
+  uint64_t lastRunning;
+  // Time the group was enabled, and actually counting, while charged.
+  uint64_t enabled;
+  uint64_t running;
+
+  // numPhases rows of counts, indexed by PerfEvent.
+  uint64_t *perPhase;
+} PerfThread;
+
+struct PerfCounters {
+  unsigned int numPhases;
+
+  // The events opened on the first thread, in group order; the others get
+  // the same group.
+  PerfEvent events[PERF_NUM_EVENTS];
+  int numEvents;
+
+  PerfThread *threads;
+  unsigned int numThreads;
+  unsigned int maxThreads;
+};
+
+// Layout of a PERF_FORMAT_GROUP read.
+typedef struct {
+  uint64_t nr;
+  uint64_t timeEnabled;
+  uint64_t timeRunning;
+  uint64_t values[PERF_NUM_EVENTS];
+} GroupReading;
+
+static int openEvent(PerfEvent event, pid_t tid, int groupFd) {
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED
+      | PERF_FORMAT_TOTAL_TIME_RUNNING;
+  switch (event) {
+    case PERF_CYCLES:
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = PERF_COUNT_HW_CPU_CYCLES;
+      break;
+    case PERF_INSTRUCTIONS:
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+      break;
+    case PERF_L1D_MISSES:
+      attr.type = PERF_TYPE_HW_CACHE;
+      attr.config = PERF_COUNT_HW_CACHE_L1D
+          | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+          | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+      break;
+    case PERF_LLC_MISSES:
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = PERF_COUNT_HW_CACHE_MISSES;
+      break;
+    default:
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+      break;
+  }
+  return syscall(SYS_perf_event_open, &attr, tid, -1, groupFd, 0);
+}
+
+static void readName(pid_t tid, char *name, size_t size) {
+  char path[64];
+  snprintf(path, sizeof(path), "/proc/self/task/%d/comm", (int) tid);
+  FILE *comm = fopen(path, "r");
+  name[0] = '\0';
+  if (comm != NULL) {
+    if (fgets(name, size, comm) != NULL) {
+      name[strcspn(name, "\n")] = '\0';
+    }
+    fclose(comm);
+  }
+}
+
+// Reads thread's group; returns 0 if the read failed.
+static int readGroup(PerfCounters *counters, PerfThread *thread,
+                     GroupReading *reading) {
+  ssize_t size = (3 + counters->numEvents) * sizeof(uint64_t);
+  return read(thread->leader, reading, size) == size;
+}
+
+// Opens the counter group on tid.  On the first thread, works out which
+// events are available, and returns errno of the leader if none is.
+static int openThread(PerfCounters *counters, pid_t tid) {
+  PerfThread thread;
+  memset(&thread, 0, sizeof(thread));
+  thread.tid = tid;
+  thread.leader = -1;
+  readName(tid, thread.name, sizeof(thread.name));
+
+  const int probing = counters->numThreads == 0 && counters->numEvents == 0;
+  int error = 0;
+  int opened = 0;
+  for (int i = 0; i < (probing ? PERF_NUM_EVENTS : counters->numEvents); i++) {
+    PerfEvent event = probing ? (PerfEvent) i : counters->events[i];
+    int fd = openEvent(event, tid, thread.leader);
+    if (fd < 0) {
+      if (error == 0) {
+        error = errno;
+      }
+      if (!probing) {
+        break;
+      }
+      continue;
+    }
+    if (thread.leader < 0) {
+      thread.leader = fd;
+    }
+    thread.fds[opened++] = fd;
+    if (probing) {
+      counters->events[counters->numEvents++] = event;
+    }
+  }
+  if (opened == 0 || opened != counters->numEvents) {
+    // a thread that doesn't get the whole group is left uncounted
+    for (int i = 0; i < opened; i++) {
+      close(thread.fds[i]);
+    }
+    return error ? error : EINVAL;
+  }
+
+  GroupReading reading;
+  if (readGroup(counters, &thread, &reading)) {
+    memcpy(thread.last, reading.values, sizeof(thread.last));
+    thread.lastEnabled = reading.timeEnabled;
+    thread.lastRunning = reading.timeRunning;
+  }
+  thread.perPhase = calloc((size_t) counters->numPhases * PERF_NUM_EVENTS,
+                           sizeof(uint64_t));
+  if (counters->numThreads == counters->maxThreads) {
+    counters->maxThreads = counters->maxThreads ? 2 * counters->maxThreads : 8;
+    counters->threads = realloc(counters->threads,
+                                counters->maxThreads * sizeof(PerfThread));
+  }
+  counters->threads[counters->numThreads++] = thread;
+  return 0;
+}
+
+// Opens counters on every thread not yet counted.  Returns errno of the
+// first failure, or 0.
+static int scanThreads(PerfCounters *counters) {
+  DIR *tasks = opendir("/proc/self/task");
+  if (tasks == NULL) {
+    return errno;
+  }
+  int error = 0;
+  struct dirent *entry;
+  while ((entry = readdir(tasks)) != NULL) {
+    pid_t tid = atoi(entry->d_name);
+    if (tid <= 0) {
+      continue;
+    }
+    int known = 0;
+    for (unsigned int i = 0; i < counters->numThreads && !known; i++) {
+      known = counters->threads[i].tid == tid;
+    }
+    if (!known) {
+      int threadError = openThread(counters, tid);
+      if (error == 0) {
+        error = threadError;
+      }
+    }
+  }
+  closedir(tasks);
+  return error;
+}
+
+PerfCounters* PerfCounters_open(unsigned int numPhases) {
+  PerfCounters *counters = calloc(1, sizeof(PerfCounters));
+  counters->numPhases = numPhases;
+  int error = scanThreads(counters);
+  if (counters->numThreads == 0) {
+    printf("Hardware counters unavailable: ");
+    if (error == ENOENT || error == EOPNOTSUPP) {
+      printf("this machine exposes no hardware counters\n");
+    } else if (error == EACCES || error == EPERM) {
+      printf("%s (see /proc/sys/kernel/perf_event_paranoid)\n",
+             strerror(error));
+    } else {
+      printf("%s\n", strerror(error));
+    }
+    PerfCounters_close(counters);
+    return NULL;
+  }
+  if (counters->numEvents < PERF_NUM_EVENTS) {
+    printf("Hardware counters: not counting");
+    for (int event = 0; event < PERF_NUM_EVENTS; event++) {
+      int available = 0;
+      for (int i = 0; i < counters->numEvents; i++) {
+        available |= counters->events[i] == (PerfEvent) event;
+      }
+      if (!available) {
+        printf(" %s,", eventNames[event]);
+      }
+    }
+    printf(" which this CPU doesn't support\n");
+  }
+  return counters;
+}
+
+void PerfCounters_scanThreads(PerfCounters *counters) {
+  scanThreads(counters);
+}
+
+// Reads every thread and, unless phase is negative, charges the counts
+// since the last reading to phase.
+static void sample(PerfCounters *counters, int phase) {
+  for (unsigned int t = 0; t < counters->numThreads; t++) {
+    PerfThread *thread = &counters->threads[t];
+    GroupReading reading;
+    if (!readGroup(counters, thread, &reading)) {
+      continue;
+    }
+    if (phase >= 0) {
+      uint64_t *counts = &thread->perPhase[phase * PERF_NUM_EVENTS];
+      for (int i = 0; i < counters->numEvents; i++) {
+        counts[counters->events[i]] += reading.values[i] - thread->last[i];
+      }
+      thread->enabled += reading.timeEnabled - thread->lastEnabled;
+      thread->running += reading.timeRunning - thread->lastRunning;
+    }
+    memcpy(thread->last, reading.values, sizeof(thread->last));
+    thread->lastEnabled = reading.timeEnabled;
+    thread->lastRunning = reading.timeRunning;
+  }
+}
+
+void PerfCounters_mark(PerfCounters *counters) {
+  sample(counters, -1);
+}
+
+void PerfCounters_charge(PerfCounters *counters, unsigned int phase) {
+  sample(counters, phase);
+}
+
+// Prints one row: the counts, IPC, and misses per thousand instructions.
+static void printCounts(const char *name, const uint64_t *counts) {
+  const double kiloInstructions = counts[PERF_INSTRUCTIONS] / 1e3;
+  printf("%-22s %12.1f %12.1f %6.2f %10.2f %10.2f %10.2f\n", name,
+         counts[PERF_CYCLES] / 1e6, counts[PERF_INSTRUCTIONS] / 1e6,
+         counts[PERF_CYCLES]
+             ? (double) counts[PERF_INSTRUCTIONS] / counts[PERF_CYCLES] : 0.0,
+         kiloInstructions ? counts[PERF_L1D_MISSES] / kiloInstructions : 0.0,
+         kiloInstructions ? counts[PERF_LLC_MISSES] / kiloInstructions : 0.0,
+         kiloInstructions ? counts[PERF_BRANCH_MISSES] / kiloInstructions
+                          : 0.0);
+}
+
+void PerfCounters_print(PerfCounters *counters,
+                        const char * const *phaseNames) {
+  printf("---- HARDWARE COUNTERS (%u threads, user space) ----\n",
+         counters->numThreads);
+  printf("%-22s %12s %12s %6s %10s %10s %10s\n", "phase", "Mcycles",
+         "Minstr", "IPC", "L1D/kinst", "LLC/kinst", "br/kinst");
+  uint64_t total[PERF_NUM_EVENTS] = {0};
+  uint64_t enabled = 0, running = 0;
+  for (unsigned int phase = 0; phase < counters->numPhases; phase++) {
+    uint64_t counts[PERF_NUM_EVENTS] = {0};
+    for (unsigned int t = 0; t < counters->numThreads; t++) {
+      for (int event = 0; event < PERF_NUM_EVENTS; event++) {
+        counts[event] +=
+            counters->threads[t].perPhase[phase * PERF_NUM_EVENTS + event];
+      }
+    }
+    for (int event = 0; event < PERF_NUM_EVENTS; event++) {
+      total[event] += counts[event];
+    }
+    printCounts(phaseNames[phase], counts);
+  }
+  printCounts("frame", total);
+
+  for (unsigned int t = 0; t < counters->numThreads; t++) {
+    PerfThread *thread = &counters->threads[t];
+    uint64_t counts[PERF_NUM_EVENTS] = {0};
+    for (unsigned int phase = 0; phase < counters->numPhases; phase++) {
+      for (int event = 0; event < PERF_NUM_EVENTS; event++) {
+        counts[event] += thread->perPhase[phase * PERF_NUM_EVENTS + event];
+      }
+    }
+    enabled += thread->enabled;
+    running += thread->running;
+    if (counts[PERF_CYCLES] == 0 && counts[PERF_INSTRUCTIONS] == 0) {
+      continue;
+    }
+    char name[48];
+    snprintf(name, sizeof(name), "%d %s", (int) thread->tid, thread->name);
+    printCounts(name, counts);
+    // where this thread spent its cycles
+    printf("%22s", "");
+    for (unsigned int phase = 0; phase < counters->numPhases; phase++) {
+      uint64_t cycles = thread->perPhase[phase * PERF_NUM_EVENTS + PERF_CYCLES];
+      if (counts[PERF_CYCLES] != 0 && 100 * cycles >= counts[PERF_CYCLES]) {
+        printf(" %s %.0f%%", phaseNames[phase],
+               100.0 * cycles / counts[PERF_CYCLES]);
+      }
+    }
+    printf("\n");
+  }
+  if (running < enabled) {
+    printf("Counters were multiplexed and ran %.1f%% of the time; "
+           "counts are not scaled\n", 100.0 * running / enabled);
+  }
+  printf("---- END HARDWARE COUNTERS ----\n");
+}
+
+void PerfCounters_close(PerfCounters *counters) {
+  for (unsigned int t = 0; t < counters->numThreads; t++) {
+    for (int i = 0; i < counters->numEvents; i++) {
+      close(counters->threads[t].fds[i]);
+    }
+    free(counters->threads[t].perPhase);
+  }
+  free(counters->threads);
+  free(counters);
+}
+
+#else  // not Linux
+
+PerfCounters* PerfCounters_open(unsigned int numPhases) {
+  printf("Hardware counters unavailable: perf_event_open needs Linux\n");
+  return NULL;
+}
+
+void PerfCounters_scanThreads(PerfCounters *counters) {}
+void PerfCounters_mark(PerfCounters *counters) {}
+void PerfCounters_charge(PerfCounters *counters, unsigned int phase) {}
+void PerfCounters_print(PerfCounters *counters,
+                        const char * const *phaseNames) {}
+void PerfCounters_close(PerfCounters *counters) {}
+
+#endif  // __linux__
@@ -0,0 +1,50 @@
+/*
+ * PerfCounters.h -- hardware performance counters per phase and thread
+ *
+ * Counts cycles, instructions, L1 data cache read misses, last-level cache
+ * misses and branch misses with perf_event_open, in user space only, on
+ * every thread of the process (the Cilk workers among them).  Each thread's
+ * counters form one group, read with a single read() at every phase
+ * boundary, and the counts since the previous boundary are charged to the
+ * phase that just ended.
+ *
+ * Counters are optional: on platforms without perf_event_open, or where it
+ * is not permitted (kernel.perf_event_paranoid, containers), opening fails
+ * with a message and the caller carries on without them.  Events the CPU
+ * doesn't support are left out individually.
+ */
+
+#ifndef PERFCOUNTERS_H_
+#define PERFCOUNTERS_H_
+
+typedef enum {
+  PERF_CYCLES,
+  PERF_INSTRUCTIONS,
+  PERF_L1D_MISSES,
+  PERF_LLC_MISSES,
+  PERF_BRANCH_MISSES,
+  PERF_NUM_EVENTS
+} PerfEvent;
+
+typedef struct PerfCounters PerfCounters;
+
+// Start counting on every current thread, charging to phases 0 to
+// numPhases - 1.  Returns NULL, after printing why, if no counter can be
+// opened.
+PerfCounters* PerfCounters_open(unsigned int numPhases);
+
+// Start counting on threads created since the last scan.
+void PerfCounters_scanThreads(PerfCounters *counters);
+
+// Start a phase: the counts so far are charged to no phase.
+void PerfCounters_mark(PerfCounters *counters);
+
+// End phase: charge it the counts since the last mark or charge.
+void PerfCounters_charge(PerfCounters *counters, unsigned int phase);
+
+// Print the counts per phase over all threads, then per thread.
+void PerfCounters_print(PerfCounters *counters, const char * const *phaseNames);
+
+void PerfCounters_close(PerfCounters *counters);
+
+#endif  // PERFCOUNTERS_H_
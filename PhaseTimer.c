@@ -0,0 +1,136 @@
+/*
+ * PhaseTimer.c -- per-phase frame timing of CollisionWorld_updateLines
+ */
+
+#include "./PhaseTimer.h"
+
+#ifdef PHASE_TIMING
+
+#include <stdlib.h>
+#include <string.h>
+
+// Frames between looks for new threads to count.
+#define PHASE_TIMER_THREAD_SCAN 1024
+
+static const char *phaseNames[NUM_PHASES] = {
+  "traverseQuadtree",
+  "staticCollisions",
+  "processCollisionList",
+  "updatePosition",
+  "getWallCollisions",
+  "updateNode",
+  "attachBuffers"
+};
+
+void PhaseTimers_init(PhaseTimers *timers) {
+  memset(timers, 0, sizeof(PhaseTimers));
+}
+
+void PhaseTimers_destroy(PhaseTimers *timers) {
+  if (timers->log != NULL) {
+    if (fclose(timers->log) != 0) {
+      perror("phase timing log");
+    }
+  }
+  if (timers->counters != NULL) {
+    PerfCounters_close(timers->counters);
+  }
+  free(timers->frames);
+}
+
+bool PhaseTimers_enableCounters(PhaseTimers *timers) {
+  if (timers->counters == NULL) {
+    timers->counters = PerfCounters_open(NUM_PHASES);
+  }
+  return timers->counters != NULL;
+}
+
+bool PhaseTimers_openLog(PhaseTimers *timers, const char *path) {
+  FILE *log = fopen(path, "w");
+  if (log == NULL) {
+    perror(path);
+    return false;
+  }
+  fprintf(log, "frame");
+  for (int phase = 0; phase < NUM_PHASES; phase++) {
+    fprintf(log, ",%s_us", phaseNames[phase]);
+  }
+  fprintf(log, ",total_us\n");
+  timers->log = log;
+  return true;
+}
+
+void PhaseTimers_endFrame(PhaseTimers *timers) {
+  if (timers->numFrames == timers->maxFrames) {
+    timers->maxFrames = timers->maxFrames ? 2 * timers->maxFrames : 1024;
+    timers->frames = realloc(timers->frames, (size_t) timers->maxFrames
+                             * NUM_PHASES * sizeof(double));
+  }
+  memcpy(&timers->frames[(size_t) timers->numFrames * NUM_PHASES],
+         timers->current, sizeof(timers->current));
+
+  if (timers->log != NULL) {
+    double total = 0;
+    fprintf(timers->log, "%u", timers->numFrames);
+    for (int phase = 0; phase < NUM_PHASES; phase++) {
+      fprintf(timers->log, ",%.3f", 1e6 * timers->current[phase]);
+      total += timers->current[phase];
+    }
+    fprintf(timers->log, ",%.3f\n", 1e6 * total);
+  }
+
+  // the Cilk workers start with the first parallel frame
+  if (timers->counters != NULL
+      && timers->numFrames % PHASE_TIMER_THREAD_SCAN == 0) {
+    PerfCounters_scanThreads(timers->counters);
+  }
+  timers->numFrames++;
+  memset(timers->current, 0, sizeof(timers->current));
+}
+
+static int compareDoubles(const void *a, const void *b) {
+  double x = *(const double *) a;
+  double y = *(const double *) b;
+  return (x > y) - (x < y);
+}
+
+// Prints one summary row of the numFrames values, sorting them.
+static void printRow(const char *name, double *values, unsigned int numFrames) {
+  qsort(values, numFrames, sizeof(double), compareDoubles);
+  double sum = 0;
+  for (unsigned int i = 0; i < numFrames; i++) {
+    sum += values[i];
+  }
+  printf("%-22s %10.1f %10.1f %10.1f %10.1f %10.1f %8.4f\n", name,
+         1e6 * values[0], 1e6 * values[numFrames / 2],
+         1e6 * values[(unsigned int) (0.99 * (numFrames - 1))],
+         1e6 * values[numFrames - 1], 1e6 * sum / numFrames, sum);
+}
+
+void PhaseTimers_print(PhaseTimers *timers) {
+  const unsigned int numFrames = timers->numFrames;
+  if (numFrames == 0) {
+    return;
+  }
+  printf("---- PHASE TIMES (us per frame over %u frames) ----\n", numFrames);
+  printf("%-22s %10s %10s %10s %10s %10s %8s\n", "phase", "min", "median",
+         "p99", "max", "mean", "total s");
+  double *values = malloc(numFrames * sizeof(double));
+  double *totals = calloc(numFrames, sizeof(double));
+  for (int phase = 0; phase < NUM_PHASES; phase++) {
+    for (unsigned int i = 0; i < numFrames; i++) {
+      values[i] = timers->frames[(size_t) i * NUM_PHASES + phase];
+      totals[i] += values[i];
+    }
+    printRow(phaseNames[phase], values, numFrames);
+  }
+  printRow("frame", totals, numFrames);
+  printf("---- END PHASE TIMES ----\n");
+  free(values);
+  free(totals);
+  if (timers->counters != NULL) {
+    PerfCounters_print(timers->counters, phaseNames);
+  }
+}
+
+#endif  // PHASE_TIMING
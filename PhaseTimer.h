@@ -0,0 +1,108 @@
+/*
+ * PhaseTimer.h -- per-phase frame timing of CollisionWorld_updateLines
+ *
+ * Built only when PHASE_TIMING is defined ("make PHASE_TIMING=1").  Each
+ * frame records the time spent in every phase of CollisionWorld_updateLines;
+ * at the end of the run the per-frame times are summarized as min, median,
+ * p99 and max per phase, and optionally every frame is logged as a CSV row.
+ *
+ * Optionally, hardware counters (PerfCounters.h) are read at the same
+ * phase boundaries and reported with the times.
+ *
+ * Without PHASE_TIMING the PHASE_TIMER_* macros expand to nothing, and
+ * CollisionWorld carries no timer state, so the timers cost nothing.
+ */
+
+#ifndef PHASETIMER_H_
+#define PHASETIMER_H_
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "./fasttime.h"
+#include "./PerfCounters.h"
+
+typedef enum {
+  PHASE_TRAVERSE_QUADTREE,
+  PHASE_STATIC_COLLISIONS,
+  PHASE_PROCESS_COLLISIONS,
+  PHASE_UPDATE_POSITION,
+  PHASE_WALL_COLLISIONS,
+  PHASE_UPDATE_NODE,
+  PHASE_ATTACH_BUFFERS,
+  NUM_PHASES
+} Phase;
+
+#ifdef PHASE_TIMING
+
+typedef struct {
+  // Start of the phase being timed.
+  fasttime_t phaseStart;
+  // Seconds spent in each phase during the current frame.
+  double current[NUM_PHASES];
+
+  // current[] of every finished frame, frame after frame.
+  double *frames;
+  unsigned int numFrames;
+  unsigned int maxFrames;
+
+  // Per-frame CSV log, or NULL.
+  FILE *log;
+
+  // Hardware counters, or NULL.
+  PerfCounters *counters;
+} PhaseTimers;
+
+void PhaseTimers_init(PhaseTimers *timers);
+
+void PhaseTimers_destroy(PhaseTimers *timers);
+
+// Log every following frame to path as CSV.  Returns false, after printing
+// why, if path can't be created.
+bool PhaseTimers_openLog(PhaseTimers *timers, const char *path);
+
+// Also count cycles, instructions, cache and branch misses per phase and
+// thread.  Returns false, after printing why, if counters are unavailable;
+// the times are recorded either way.
+bool PhaseTimers_enableCounters(PhaseTimers *timers);
+
+// Record the current frame and start the next one.
+void PhaseTimers_endFrame(PhaseTimers *timers);
+
+// Print min, median, p99 and max of every phase over the recorded frames,
+// and the hardware counts if enabled.
+void PhaseTimers_print(PhaseTimers *timers);
+
+static inline void PhaseTimers_start(PhaseTimers *timers) {
+  if (timers->counters != NULL) {
+    PerfCounters_mark(timers->counters);
+  }
+  timers->phaseStart = gettime();
+}
+
+// Charge the time since the last start or stop to phase; the next phase
+// starts now.
+static inline void PhaseTimers_stop(PhaseTimers *timers, Phase phase) {
+  const fasttime_t now = gettime();
+  timers->current[phase] += tdiff(timers->phaseStart, now);
+  if (timers->counters != NULL) {
+    PerfCounters_charge(timers->counters, phase);
+    timers->phaseStart = gettime();
+  } else {
+    timers->phaseStart = now;
+  }
+}
+
+#define PHASE_TIMER_START(timers) PhaseTimers_start(timers)
+#define PHASE_TIMER_STOP(timers, phase) PhaseTimers_stop(timers, phase)
+#define PHASE_TIMER_END_FRAME(timers) PhaseTimers_endFrame(timers)
+
+#else
+
+#define PHASE_TIMER_START(timers)
+#define PHASE_TIMER_STOP(timers, phase)
+#define PHASE_TIMER_END_FRAME(timers)
+
+#endif  // PHASE_TIMING
+
+#endif  // PHASETIMER_H_
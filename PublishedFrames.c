@@ -0,0 +1,91 @@
+/*
+ * PublishedFrames.c -- double-buffered line positions for concurrent readers
+ */
+
+#include "./PublishedFrames.h"
+
+#include <sched.h>
+#include <stdlib.h>
+#include <cilk/cilk.h>
+
+#include "./fasttime.h"
+
+// The orderings are sequentially consistent: a reader's count must be
+// visible to the simulation before the reader re-reads the epoch, and the
+// simulation's epoch store before it reads the counts.
+
+static void fillFrame(PublishedFrame *frame, CollisionWorld *collisionWorld) {
+  const unsigned int numOfLines = collisionWorld->numOfLines;
+  if (numOfLines > frame->capacity) {
+    free(frame->lines);
+    frame->capacity = numOfLines;
+    frame->lines = malloc(numOfLines * sizeof(PublishedLine));
+  }
+  cilk_for (unsigned int i = 0; i < numOfLines; i++) {
+    const Line *line = collisionWorld->lines[i];
+    PublishedLine *published = &frame->lines[i];
+    published->p1 = line->p1;
+    published->p2 = line->p2;
+    published->id = line->id;
+    published->color = line->color;
+    published->kind = line->kind;
+  }
+  frame->numOfLines = numOfLines;
+  frame->frame = collisionWorld->frame;
+}
+
+PublishedFrames* PublishedFrames_new(CollisionWorld *collisionWorld) {
+  PublishedFrames *publishedFrames = calloc(1, sizeof(PublishedFrames));
+  fillFrame(&publishedFrames->frames[0], collisionWorld);
+  return publishedFrames;
+}
+
+void PublishedFrames_delete(PublishedFrames *publishedFrames) {
+  if (publishedFrames == NULL) {
+    return;
+  }
+  free(publishedFrames->frames[0].lines);
+  free(publishedFrames->frames[1].lines);
+  free(publishedFrames);
+}
+
+void PublishedFrames_publish(PublishedFrames *publishedFrames,
+                             CollisionWorld *collisionWorld) {
+  // only the simulation changes the epoch
+  const unsigned long long epoch = publishedFrames->epoch + 1;
+  PublishedFrame *frame = &publishedFrames->frames[epoch & 1];
+  if (__atomic_load_n(&frame->readers, __ATOMIC_SEQ_CST) != 0) {
+    const fasttime_t start = gettime();
+    while (__atomic_load_n(&frame->readers, __ATOMIC_SEQ_CST) != 0) {
+      sched_yield();
+    }
+    publishedFrames->waitSeconds += tdiff(start, gettime());
+  }
+  fillFrame(frame, collisionWorld);
+  frame->epoch = epoch;
+  __atomic_store_n(&publishedFrames->epoch, epoch, __ATOMIC_SEQ_CST);
+}
+
+unsigned long long PublishedFrames_epoch(PublishedFrames *publishedFrames) {
+  return __atomic_load_n(&publishedFrames->epoch, __ATOMIC_SEQ_CST);
+}
+
+const PublishedFrame* PublishedFrames_acquire(
+    PublishedFrames *publishedFrames) {
+  while (true) {
+    const unsigned long long epoch = PublishedFrames_epoch(publishedFrames);
+    PublishedFrame *frame = &publishedFrames->frames[epoch & 1];
+    __atomic_add_fetch(&frame->readers, 1, __ATOMIC_SEQ_CST);
+    // if the epoch moved, the simulation may already be refilling frame
+    if (PublishedFrames_epoch(publishedFrames) == epoch) {
+      return frame;
+    }
+    __atomic_sub_fetch(&frame->readers, 1, __ATOMIC_SEQ_CST);
+  }
+}
+
+void PublishedFrames_release(PublishedFrames *publishedFrames,
+                             const PublishedFrame *frame) {
+  PublishedFrame *held = &publishedFrames->frames[frame->epoch & 1];
+  __atomic_sub_fetch(&held->readers, 1, __ATOMIC_SEQ_CST);
+}
@@ -0,0 +1,73 @@
+/*
+ * PublishedFrames.h -- double-buffered line positions for concurrent readers
+ *
+ * Once publishing is enabled, a CollisionWorld copies every live line's
+ * endpoints, id, colour and kind into one of two frame buffers at the end
+ * of each frame, and publishes it by advancing an epoch whose low bit names
+ * the published buffer.  Readers on other threads, such as the renderer,
+ * acquire the published frame and read it while the simulation computes
+ * the next one.
+ *
+ * Neither side takes a lock.  A reader counts itself on the buffer and
+ * then checks that the epoch didn't move meanwhile, retrying if it did.
+ * The simulation only waits before overwriting the unpublished buffer
+ * while a reader still holds it, so it never runs more than one frame
+ * ahead of its slowest reader.
+ */
+
+#ifndef PUBLISHEDFRAMES_H_
+#define PUBLISHEDFRAMES_H_
+
+#include "./CollisionWorld.h"
+#include "./Line.h"
+
+typedef struct {
+  Vec p1;
+  Vec p2;
+  unsigned int id;
+  Color color;
+  LineKind kind;
+} PublishedLine;
+
+// One buffer: the live lines in index order after frame frames.
+typedef struct {
+  PublishedLine *lines;
+  unsigned int numOfLines;
+  unsigned int capacity;
+  unsigned int frame;
+  unsigned long long epoch;  // the epoch that published it
+  unsigned int readers;      // readers holding it, updated atomically
+} PublishedFrame;
+
+typedef struct PublishedFrames {
+  PublishedFrame frames[2];
+  // Number of frames published; frames[epoch & 1] is the latest.
+  unsigned long long epoch;
+  // Time the simulation spent waiting for readers to let go of a buffer.
+  double waitSeconds;
+} PublishedFrames;
+
+// Create the buffers and publish collisionWorld's current lines.
+PublishedFrames* PublishedFrames_new(CollisionWorld *collisionWorld);
+
+// Free the buffers.  No reader may hold one.
+void PublishedFrames_delete(PublishedFrames *publishedFrames);
+
+// Copy collisionWorld's lines into the unpublished buffer, once no reader
+// holds it, and publish it.  Called by the simulation between frames.
+void PublishedFrames_publish(PublishedFrames *publishedFrames,
+                             CollisionWorld *collisionWorld);
+
+// The number of frames published so far.
+unsigned long long PublishedFrames_epoch(PublishedFrames *publishedFrames);
+
+// The latest published frame, which stays valid and unchanged until it is
+// released.  Hold it for no longer than a frame or two: the simulation
+// waits for it before publishing the frame after next.
+const PublishedFrame* PublishedFrames_acquire(
+    PublishedFrames *publishedFrames);
+
+void PublishedFrames_release(PublishedFrames *publishedFrames,
+                             const PublishedFrame *frame);
+
+#endif  // PUBLISHEDFRAMES_H_
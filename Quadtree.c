@@ -16,6 +16,9 @@ Figure out where to add passing down information down the quadtree
 #include "./Vec.h"
 #include "./CollisionWorld.h"
 #include "./IntersectionEventList.h"
+#include "./Tracer.h"
+#include "./HeatMap.h"
+#include "./MemoryStats.h"
 
 #include <stdlib.h>
 #include <math.h>
@@ -33,13 +36,17 @@ quadrant_t getLineQuadrant(Node * node, Line * l);
 // get's the quadrant within the node that the vector belongs to.
 quadrant_t getPointQuadrant(Node *node, Vec * vector);
 
-//If necessary (too many lines), split up the node into 4
-void divideNode(Node * node);
+//If necessary (maxLines lines or more), split up the node into 4
+void divideNode(Node * node, unsigned int maxLines);
+
+// Narrow-phase test of a pair, skipped while its pair certificate holds.
+static inline void testLinePair(Line * line, Line * other,
+		IntersectionEventList * events, CollisionWorld * collisionWorld);
 // ======================================================
-inline int overlapsRight(Line *line);
-inline int overlapsLeft(Line *line);
-inline int overlapsTop(Line *line);
-inline int overlapsBottom(Line *line);
+inline int overlapsRight(Line *line, double timeStep);
+inline int overlapsLeft(Line *line, double timeStep);
+inline int overlapsTop(Line *line, double timeStep);
+inline int overlapsBottom(Line *line, double timeStep);
 // =======================================================
 
 
@@ -47,7 +54,8 @@ inline int overlapsBottom(Line *line);
 //	allLineNodes = malloc(numberOfLines * sizeof(LineNode *));
 //}
 
-int maxLines = 50;
+// Cap on node certificates, used for lines that never move.
+#define NODE_CERTIFICATE_MAX (1 << 30)
 
 int nodeContainsPoint(Node *node, Vec * v){
 
@@ -58,7 +66,7 @@ int nodeContainsPoint(Node *node, Vec * v){
 }
 
 
-int nodeContainsLine(Node *node, Line *l, double time){
+int nodeContainsLine(Node *node, Line *l){
 
 	Vec * p1;
 	Vec * p2;
@@ -129,6 +137,72 @@ quadrant_t getLineQuadrant(Node * node, Line * line){
 }
 
 
+// Frames needed to cover distance when moving step per frame.
+static inline double framesToTravel(double distance, double step) {
+	if (step == 0) {
+		return NODE_CERTIFICATE_MAX;
+	}
+	return floor(distance / step);
+}
+
+// Frames before the interval [lo, hi] moving by v per frame could cross
+// min or max.
+static inline double framesToLeave(double lo, double hi, double min,
+		double max, double v) {
+	if (v > 0) {
+		return framesToTravel(max - hi, v);
+	}
+	return framesToTravel(lo - min, -v);
+}
+
+// Frames before the interval [lo, hi] moving by v per frame could lie
+// entirely on one side of mid.
+static inline double framesToClear(double lo, double hi, double mid, double v) {
+	if (v > 0) {
+		return framesToTravel(mid - lo, v);
+	}
+	return framesToTravel(hi - mid, -v);
+}
+
+/*
+Lower bound on the number of frames before the line could leave the node,
+or fit into one of its children, assuming its velocity stays the same.
+Both come from the distance between the line's swept box and the node's
+edges/midlines divided by how far the line moves per frame.
+*/
+unsigned int nodeCertificate(Node * node, Line * line, double timeStep) {
+	double vx = timeStep * line->velocity.x;
+	double vy = timeStep * line->velocity.y;
+	double frames = NODE_CERTIFICATE_MAX;
+
+	// lines never leave the root
+	if (node->parent != NULL) {
+		double leaveX = framesToLeave(line->sweptXmin, line->sweptXmax,
+				node->xMin, node->xMax, vx);
+		double leaveY = framesToLeave(line->sweptYmin, line->sweptYmax,
+				node->yMin, node->yMax, vy);
+		frames = fmin(frames, fmin(leaveX, leaveY));
+	}
+
+	// to fit into a child, the line has to clear every midline it straddles
+	if (node->nw != NULL) {
+		double xMid = (node->xMin + node->xMax)/2.0;
+		double yMid = (node->yMin + node->yMax)/2.0;
+		double fit = 0;
+		if (line->sweptXmin < xMid && line->sweptXmax >= xMid) {
+			fit = fmax(fit, framesToClear(line->sweptXmin, line->sweptXmax, xMid, vx));
+		}
+		if (line->sweptYmin < yMid && line->sweptYmax >= yMid) {
+			fit = fmax(fit, framesToClear(line->sweptYmin, line->sweptYmax, yMid, vy));
+		}
+		frames = fmin(frames, fit);
+	}
+
+	// leave a frame of slack for rounding in the position updates
+	frames -= 1;
+	return frames > 0 ? (unsigned int) frames : 0;
+}
+
 // This instantiates the root of the initial quadtree.
 Node * instantiateRoot(CollisionWorld * collisionWorld) {
 	Node * root = create_node(BOX_XMIN, BOX_XMAX, BOX_YMIN, BOX_YMAX);
@@ -139,13 +213,274 @@ Node * instantiateRoot(CollisionWorld * collisionWorld) {
 	// root->enclosedLines = malloc(collisionWorld->numOfLines * sizeof(Line *));
 
 	for (int i = 0; i < collisionWorld->numOfLines; i++) {
+		// static lines live in their own index
+		if (collisionWorld->lines[i]->kind == STATIC_LINE) {
+			continue;
+		}
 		addQuadtreeLineNode(root, createLineNode(root->lines, collisionWorld->lines[i]));
 	}
-	divideNode(root);
+	divideNode(root, collisionWorld->maxLinesPerNode);
+	return root;
+}
+
+// This builds the immutable index over the static lines.  It is never
+// passed through updateNode or attachBuffers.
+Node * instantiateStaticIndex(CollisionWorld * collisionWorld) {
+	if (collisionWorld->numOfStaticLines == 0) {
+		return NULL;
+	}
+	Node * root = create_node(BOX_XMIN, BOX_XMAX, BOX_YMIN, BOX_YMAX);
+	root->parent = NULL;
+	for (int i = 0; i < collisionWorld->numOfStaticLines; i++) {
+		addQuadtreeLineNode(root, createLineNode(root->lines, collisionWorld->staticLines[i]));
+	}
+	divideNode(root, collisionWorld->maxLinesPerNode);
+	return root;
+}
+
+// Lines per block of the parallel partition in bulkBuildNode; nodes with
+// fewer lines are partitioned serially.
+#define BULK_BUILD_BLOCK 4096
+
+// Gives node the list instantiateRoot would: the lines prepended in order.
+static void bulkBuildList(Node * node, Line ** lines, unsigned int numberOfLines) {
+	for (unsigned int i = 0; i < numberOfLines; i++) {
+		addQuadtreeLineNode(node, createLineNode(node->lines, lines[i]));
+	}
+}
+
+// Classifies the lines [begin, end) of one block and counts them per
+// quadrant.  lines is walked backwards, since divideNode walks the list
+// instantiateRoot built by prepending.
+static void bulkBuildClassifyBlock(Node * node, Line ** lines,
+		unsigned int numberOfLines, unsigned int begin, unsigned int end,
+		unsigned char * quadrants, unsigned int * counts) {
+	for (unsigned int i = begin; i < end; i++) {
+		Line * line = lines[numberOfLines - 1 - i];
+		// the node is being split, so old certificates no longer apply
+		line->nodeCertificate = 0;
+		quadrants[i] = getLineQuadrant(node, line);
+		counts[quadrants[i]]++;
+	}
+}
+
+// Moves the lines of one block to their buckets, starting at counts.
+static void bulkBuildScatterBlock(Line ** lines, unsigned int numberOfLines,
+		unsigned int begin, unsigned int end, const unsigned char * quadrants,
+		unsigned int * counts, Line ** out) {
+	for (unsigned int i = begin; i < end; i++) {
+		out[counts[quadrants[i]]++] = lines[numberOfLines - 1 - i];
+	}
+}
+
+// Builds the subtree under node from lines, given in the order divideNode
+// would prepend them, the same way instantiateRoot and divideNode do.
+// Each line is classified once per level, the lines are partitioned into
+// scratch stably and in parallel, and the children are built in parallel
+// with the two arrays swapped.  quadrants has room for numberOfLines.
+static void bulkBuildNode(Node * node, Line ** lines, Line ** scratch,
+		unsigned char * quadrants, unsigned int numberOfLines,
+		unsigned int maxLines) {
+	if (numberOfLines < maxLines) {
+		bulkBuildList(node, lines, numberOfLines);
+		return;
+	}
+
+	double xMid = (node->xMin + node->xMax) / 2.0;
+	double yMid = (node->yMin + node->yMax) / 2.0;
+	node->nw = create_node(node->xMin, xMid, yMid, node->yMax);
+	node->ne = create_node(xMid, node->xMax, yMid, node->yMax);
+	node->sw = create_node(node->xMin, xMid, node->yMin, yMid);
+	node->se = create_node(xMid, node->xMax, node->yMin, yMid);
+	node->nw->parent = node;
+	node->ne->parent = node;
+	node->sw->parent = node;
+	node->se->parent = node;
+
+	// each block's share of each bucket, turned into its output offsets
+	unsigned int numBlocks = (numberOfLines + BULK_BUILD_BLOCK - 1) / BULK_BUILD_BLOCK;
+	unsigned int (*counts)[NONE + 1] = calloc(numBlocks, sizeof(*counts));
+	cilk_for (unsigned int b = 0; b < numBlocks; b++) {
+		unsigned int end = (b + 1) * BULK_BUILD_BLOCK;
+		bulkBuildClassifyBlock(node, lines, numberOfLines, b * BULK_BUILD_BLOCK,
+				end < numberOfLines ? end : numberOfLines, quadrants, counts[b]);
+	}
+	unsigned int bucketStart[NONE + 2];
+	unsigned int offset = 0;
+	for (int q = NW; q <= NONE; q++) {
+		bucketStart[q] = offset;
+		for (unsigned int b = 0; b < numBlocks; b++) {
+			unsigned int count = counts[b][q];
+			counts[b][q] = offset;
+			offset += count;
+		}
+	}
+	bucketStart[NONE + 1] = offset;
+	cilk_for (unsigned int b = 0; b < numBlocks; b++) {
+		unsigned int end = (b + 1) * BULK_BUILD_BLOCK;
+		bulkBuildScatterBlock(lines, numberOfLines, b * BULK_BUILD_BLOCK,
+				end < numberOfLines ? end : numberOfLines, quadrants, counts[b],
+				scratch);
+	}
+	free(counts);
+
+	// lines that straddle a midline stay here
+	bulkBuildList(node, &scratch[bucketStart[NONE]],
+			bucketStart[NONE + 1] - bucketStart[NONE]);
+
+	Node * children[NONE] = {node->nw, node->ne, node->se, node->sw};
+	for (int q = NW; q < NONE; q++) {
+		cilk_spawn bulkBuildNode(children[q], &scratch[bucketStart[q]],
+				&lines[bucketStart[q]], &quadrants[bucketStart[q]],
+				bucketStart[q + 1] - bucketStart[q], maxLines);
+	}
+	cilk_sync;
+}
+
+#ifndef NDEBUG
+// Whether two trees have the same shape, bounds and line lists.
+static int sameQuadtree(Node * a, Node * b) {
+	if (a == NULL || b == NULL) {
+		return a == b;
+	}
+	if (a->xMin != b->xMin || a->xMax != b->xMax || a->yMin != b->yMin
+			|| a->yMax != b->yMax || a->numberOfLines != b->numberOfLines) {
+		return 0;
+	}
+	LineNode * x = a->lines;
+	LineNode * y = b->lines;
+	for (; x != NULL && y != NULL; x = x->next, y = y->next) {
+		if (x->line != y->line) {
+			return 0;
+		}
+	}
+	if (x != NULL || y != NULL
+			|| (a->firstQuadtreeLineNode == NULL) != (b->firstQuadtreeLineNode == NULL)
+			|| (a->firstQuadtreeLineNode != NULL
+					&& a->firstQuadtreeLineNode->line != b->firstQuadtreeLineNode->line)) {
+		return 0;
+	}
+	return sameQuadtree(a->nw, b->nw) && sameQuadtree(a->ne, b->ne)
+			&& sameQuadtree(a->sw, b->sw) && sameQuadtree(a->se, b->se);
+}
+#endif
+
+// Builds the same tree as instantiateRoot, in parallel.
+Node * bulkBuildRoot(CollisionWorld * collisionWorld) {
+	Node * root = create_node(BOX_XMIN, BOX_XMAX, BOX_YMIN, BOX_YMAX);
+	root->parent = NULL;
+
+#ifndef NDEBUG
+	// built first, so the lines end up pointing into the tree returned
+	Node * reference = instantiateRoot(collisionWorld);
+#endif
+	Line ** lines = malloc(collisionWorld->numOfLines * sizeof(Line *));
+	Line ** scratch = malloc(collisionWorld->numOfLines * sizeof(Line *));
+	unsigned char * quadrants = malloc(collisionWorld->numOfLines);
+	unsigned int numberOfLines = 0;
+	for (unsigned int i = 0; i < collisionWorld->numOfLines; i++) {
+		// static lines live in their own index
+		if (collisionWorld->lines[i]->kind != STATIC_LINE) {
+			lines[numberOfLines++] = collisionWorld->lines[i];
+		}
+	}
+	bulkBuildNode(root, lines, scratch, quadrants, numberOfLines,
+			collisionWorld->maxLinesPerNode);
+	free(lines);
+	free(scratch);
+	free(quadrants);
+
+#ifndef NDEBUG
+	assert(sameQuadtree(root, reference));
+	freeNode(reference);
+#endif
 	return root;
 }
 
-void attachBuffers(Node * node) {
+// Returns the child of node for quadrant, which must not be NONE.
+static Node * childForQuadrant(Node * node, quadrant_t quadrant) {
+	switch (quadrant) {
+		case NW: return node->nw;
+		case NE: return node->ne;
+		case SE: return node->se;
+		default: return node->sw;
+	}
+}
+
+// Inserts a line between frames, at the node updateNode would place it
+// in, splitting that node if it becomes too full.
+void insertQuadtreeLine(Node * root, Line * line, unsigned int maxLines) {
+	Node * node = root;
+	while (node->nw != NULL) {
+		quadrant_t quadrant = getLineQuadrant(node, line);
+		if (quadrant == NONE) {
+			break;
+		}
+		node = childForQuadrant(node, quadrant);
+	}
+	line->nodeCertificate = 0;
+	addQuadtreeLineNode(node, createLineNode(node->lines, line));
+	if (node->nw == NULL) {
+		divideNode(node, maxLines);
+	}
+}
+
+// Removes a line between frames, in constant time.  The lists are singly
+// linked, so rather than finding the entry before the line's, the line at
+// the head of its node's list takes over the line's entry and the head
+// entry is freed.
+void removeQuadtreeLine(Line * line) {
+	Node * node = line->quadtreeNode;
+	LineNode * lineNode = line->quadtreeLineNode;
+	LineNode * head = node->lines;
+	assert(lineNode->line == line && node->bufferLineCount == 0);
+	if (head != lineNode) {
+		lineNode->line = head->line;
+		head->line->quadtreeLineNode = lineNode;
+	}
+	node->lines = head->next;
+	if (node->firstQuadtreeLineNode == head) {
+		// head was the only entry
+		node->firstQuadtreeLineNode = NULL;
+	}
+	node->numberOfLines--;
+	free(head);
+	MEMORY_FREE(MEMORY_LINE_NODE, sizeof(LineNode));
+	line->quadtreeNode = NULL;
+	line->quadtreeLineNode = NULL;
+}
+
+// Read-only query of the static index: appends an event for every static
+// line the dynamic line will hit.  Only descends into children whose
+// bounds overlap the line's swept box.
+void queryStaticIndex(Node * node, Line * line,
+		CollisionWorld * collisionWorld) {
+	IntersectionEventList * events = &REDUCER_VIEW(collisionWorld->events);
+	LineNode * currentLineNode = node->lines;
+	while (currentLineNode != NULL) {
+		Line * staticLine = currentLineNode->line;
+		currentLineNode = currentLineNode->next;
+		if (line->sweptXmax < staticLine->sweptXmin || line->sweptXmin > staticLine->sweptXmax
+				|| line->sweptYmax < staticLine->sweptYmin || line->sweptYmin > staticLine->sweptYmax) {
+			events->boxRejects++;
+			continue;
+		}
+		testLinePair(line, staticLine, events, collisionWorld);
+	}
+	if (node->nw == NULL) {
+		return;
+	}
+	Node * children[4] = {node->nw, node->ne, node->sw, node->se};
+	for (int i = 0; i < 4; i++) {
+		Node * child = children[i];
+		if (line->sweptXmax >= child->xMin && line->sweptXmin <= child->xMax
+				&& line->sweptYmax >= child->yMin && line->sweptYmin <= child->yMax) {
+			queryStaticIndex(child, line, collisionWorld);
+		}
+	}
+}
+
+void attachBuffers(Node * node, unsigned int maxLines) {
 	//Attach the lines in the buffer to the lines currently in the node
 	if (node->bufferLineCount != 0) {
 		if (node->numberOfLines == 0) {
@@ -159,17 +494,17 @@ void attachBuffers(Node * node) {
 		node->bufferLineCount = 0;
 	}
 	if (node->nw !=NULL) {
-		attachBuffers(node->nw);
-		attachBuffers(node->ne);
-		attachBuffers(node->sw);
-		attachBuffers(node->se);
+		attachBuffers(node->nw, maxLines);
+		attachBuffers(node->ne, maxLines);
+		attachBuffers(node->sw, maxLines);
+		attachBuffers(node->se, maxLines);
 	} else {
-		divideNode(node);
+		divideNode(node, maxLines);
 	}
 }
 
 void insertLineNodeUpwardDuringUpdate(Node * node, LineNode * lineNode) {
-	int inQuadrant = nodeContainsLine(node, lineNode->line, globalTimeStep);
+	int inQuadrant = nodeContainsLine(node, lineNode->line);
 	if (inQuadrant == 0) {
 		if (node->parent != NULL) {
 			insertLineNodeUpwardDuringUpdate(node->parent, lineNode);
@@ -219,9 +554,12 @@ void insertLineNodeDownwardDuringUpdate(Node * node, LineNode * lineNode) {
 
 //Starting from the root, call this function on each node in order to test each line to see
 //if it belongs in the node still
-void updateNode(Node * root) {
+void updateNode(Node * root, double timeStep) {
 	LineNode * currentLineNode = root->lines;
-	LineNode * previousLineNode = createLineNode(root->lines,NULL);
+	LineNode * previousLineNode = malloc(sizeof(LineNode));
+	MEMORY_ALLOC(MEMORY_SENTINEL, sizeof(LineNode));
+	previousLineNode->next = root->lines;
+	previousLineNode->line = NULL;
 	LineNode * firstLineNode = previousLineNode;
 	LineNode * tempLineNode;
 
@@ -231,7 +569,20 @@ void updateNode(Node * root) {
 		// this is what the next linenode we process is
 		tempLineNode = currentLineNode->next;
 		Line * line = currentLineNode->line;
-		int contains = nodeContainsLine(root, line, globalTimeStep);
+		if (line->asleep) {
+			// sleeping lines don't move, so they stay where they are
+			previousLineNode = currentLineNode;
+			currentLineNode = tempLineNode;
+			continue;
+		}
+		if (line->nodeCertificate > 0) {
+			// the certificate proves the line still belongs here
+			line->nodeCertificate--;
+			previousLineNode = currentLineNode;
+			currentLineNode = tempLineNode;
+			continue;
+		}
+		int contains = nodeContainsLine(root, line);
 		if (contains == 0) { //linenode not in quadtreenode
 			if (root->parent != NULL) {
 				// go to the parent
@@ -274,6 +625,7 @@ void updateNode(Node * root) {
 					break;
 				default:
 					previousLineNode = currentLineNode;
+					line->nodeCertificate = nodeCertificate(root, line, timeStep);
 					break;
 				}
 			}
@@ -282,6 +634,7 @@ void updateNode(Node * root) {
 				//previousLineNode to current and moving currentLineNode forward in the code
 				//5 lines below
 				previousLineNode = currentLineNode;
+				line->nodeCertificate = nodeCertificate(root, line, timeStep);
 			}
 		}
 
@@ -298,16 +651,17 @@ void updateNode(Node * root) {
 	}
 
 	if (root->nw != NULL) {
-		updateNode(root->nw);
-		updateNode(root->ne);
-		updateNode(root->sw);
-		updateNode(root->se);
+		updateNode(root->nw, timeStep);
+		updateNode(root->ne, timeStep);
+		updateNode(root->sw, timeStep);
+		updateNode(root->se, timeStep);
 	}
 
 	free(firstLineNode);
+	MEMORY_FREE(MEMORY_SENTINEL, sizeof(LineNode));
 }
 
-void divideNode(Node *node){
+void divideNode(Node *node, unsigned int maxLines){
 	int numberOfLines = node->numberOfLines;
 	if (numberOfLines < maxLines) {
 		return;
@@ -342,6 +696,8 @@ void divideNode(Node *node){
 	while (currentLineNode != NULL) {
 		Line * line = currentLineNode->line;
 		LineNode * tempLineNode = currentLineNode->next;
+		// the node is being split, so old certificates no longer apply
+		line->nodeCertificate = 0;
 		quadrant_t quadrant = getLineQuadrant(node, line);
 		if (quadrant == NONE) {
 			// newLines[numberOfNewLines] = line;
@@ -379,15 +735,16 @@ void divideNode(Node *node){
 	// node->enclosedLines = newLines;
 	// free(tempLineListPointer);
 
-	divideNode(node->nw);
-	divideNode(node->ne);
-	divideNode(node->se);
-	divideNode(node->sw);
+	divideNode(node->nw, maxLines);
+	divideNode(node->ne, maxLines);
+	divideNode(node->se, maxLines);
+	divideNode(node->sw, maxLines);
 }
 
 // This is to initialize any line node, with the next pointer passed in.
 LineNode * createLineNode(LineNode * lineNode, Line * line) {
 	LineNode * newLineNode = malloc(sizeof(LineNode));
+	MEMORY_ALLOC(MEMORY_LINE_NODE, sizeof(LineNode));
 	newLineNode->next = lineNode;
 	newLineNode->line = line;
 	return newLineNode;
@@ -400,7 +757,7 @@ void quadtreeFree(Node *root){
 }
 
 
-static inline void helperAddLineNode(Line * line, Line * nextLine, IntersectionEventListReducer * intersectionEventListReducer) {
+static inline void helperAddLineNode(Line * line, Line * nextLine, CollisionWorld * collisionWorld) {
 	Line * firstLine, * secondLine;
 	if (compareLines(line, nextLine) < 0) {
 		firstLine = line;
@@ -409,140 +766,191 @@ static inline void helperAddLineNode(Line * line, Line * nextLine, IntersectionE
 		firstLine = nextLine;
 		secondLine = line;
 	}
-	IntersectionType intersectionType = intersect(firstLine, secondLine, globalTimeStep);
+	IntersectionType intersectionType = intersect(firstLine, secondLine, collisionWorld->timeStep);
 	if (intersectionType != NO_INTERSECTION) {
-		IntersectionEventList_appendNode(&REDUCER_VIEW(*intersectionEventListReducer),
+		IntersectionEventList_appendNode(&REDUCER_VIEW(collisionWorld->events),
 				firstLine, secondLine, intersectionType);
 	}
 }
 
 // This adds line nodes to the list for intersection processing.
 LineNode * addLineNode(Line * line, LineNode * lineNode,
-		IntersectionEventListReducer * intersectionEventListReducer) {
+		CollisionWorld * collisionWorld) {
 
 	LineNode * newLineNode = createLineNode(lineNode, line);
 	LineNode * nextLineNode = newLineNode->next;
 
 	//traverse through the linked list, comparing the newly added line to each thing
 	while (nextLineNode != NULL) {
-		 helperAddLineNode(line, nextLineNode->line, intersectionEventListReducer);
+		 helperAddLineNode(line, nextLineNode->line, collisionWorld);
 		nextLineNode = nextLineNode->next;
 	}
 	;
 	return newLineNode;
 }
 
+// Narrow-phase test of a pair that passed the box prefilter.  line owns
+// the pair certificate, so only the task processing line writes to it.
+static inline void testLinePair(Line * line, Line * other,
+		IntersectionEventList * events, CollisionWorld * collisionWorld) {
+	PairCertificate * certificate =
+			&line->pairCertificates[other->id & (PAIR_CERTIFICATE_SLOTS - 1)];
+	if (certificate->otherId == other->id
+			&& certificate->otherVelocityVersion == other->velocityVersion
+			&& collisionWorld->frame <= certificate->expires) {
+		events->narrowPhaseSkips++;
+		return;
+	}
+
+	Line * firstLine, * secondLine;
+	if (line->id < other->id) {
+		firstLine = line;
+		secondLine = other;
+	} else {
+		firstLine = other;
+		secondLine = line;
+	}
+	events->narrowPhaseTests++;
+	IntersectionType intersectionType = intersect(firstLine, secondLine, collisionWorld->timeStep);
+	if (intersectionType != NO_INTERSECTION) {
+		IntersectionEventList_appendNode(events, firstLine, secondLine, intersectionType);
+		return;
+	}
+
+	unsigned int frames = framesToContact(line, other, collisionWorld->timeStep);
+	if (frames > 0) {
+		certificate->otherId = other->id;
+		certificate->otherVelocityVersion = other->velocityVersion;
+		certificate->expires = collisionWorld->frame + frames;
+	}
+}
+
 void testNewCollisionLineNode(LineNode * lineNode,
-		IntersectionEventListReducer * intersectionEventListReducer) {
+		CollisionWorld * collisionWorld) {
+	IntersectionEventList * events = &REDUCER_VIEW(collisionWorld->events);
 	LineNode * nextLineNode = lineNode->next;
 	Line * line = lineNode->line;
 	Line * nextLine;
+	unsigned long rejects = 0;
 	//traverse through the linked list, comparing the newly added line to each thing
 	while (nextLineNode != NULL) {
 		nextLine = nextLineNode->line;
-		Line * firstLine, * secondLine;
 
-	    if(line->maxXpointer->x < nextLine->minXpointer->x || line->minXpointer->x > nextLine->maxXpointer->x
-			  || line->maxYpointer->y < nextLine->minYpointer->y || line->minYpointer->y > nextLine->maxYpointer->y){
+	    // two sleeping lines can never collide
+	    if((line->asleep && nextLine->asleep)
+			  || line->sweptXmax < nextLine->sweptXmin || line->sweptXmin > nextLine->sweptXmax
+			  || line->sweptYmax < nextLine->sweptYmin || line->sweptYmin > nextLine->sweptYmax){
+	    	rejects++;
 	    	nextLineNode = nextLineNode->next;
 	    	continue;
 	    }
-	    if (line->id < nextLine->id) {
-			firstLine = line;
-			secondLine = nextLine;
-		} else {
-			firstLine = nextLine;
-			secondLine = line;
-		}
-		IntersectionType intersectionType = intersect(firstLine, secondLine, globalTimeStep);
-		if (intersectionType != NO_INTERSECTION) {
-			IntersectionEventList_appendNode(&REDUCER_VIEW(*intersectionEventListReducer),
-					firstLine, secondLine, intersectionType);
-		}
+		testLinePair(line, nextLine, events, collisionWorld);
 		nextLineNode = nextLineNode->next;
 	}
+	events->boxRejects += rejects;
 
 	return;
 }
 
 //l_node points to the head of the linked list that contains the rest of the points
-void traverseQuadtree(Node *node,
-		IntersectionEventListReducer * intersectionEventListReducer,
+void traverseQuadtree(Node *node, CollisionWorld * collisionWorld,
 		LineNode * lineNode){
 	//iterate through each of the lines and attach each to the front of the linked list
 		//by creating a linkedLineNode with the line and pointing it to the head
 	if (node->numberOfLines == 0) {
 //		return intersectionEventListReducer;
 		if (node->nw != NULL) {
-			cilk_spawn traverseQuadtree(node->nw, intersectionEventListReducer, lineNode);
-			cilk_spawn traverseQuadtree(node->ne, intersectionEventListReducer, lineNode);
-			cilk_spawn traverseQuadtree(node->sw, intersectionEventListReducer, lineNode);
-			cilk_spawn traverseQuadtree(node->se, intersectionEventListReducer, lineNode);
+			TRACE_BEGIN(subtree);
+			cilk_spawn traverseQuadtree(node->nw, collisionWorld, lineNode);
+			cilk_spawn traverseQuadtree(node->ne, collisionWorld, lineNode);
+			cilk_spawn traverseQuadtree(node->sw, collisionWorld, lineNode);
+			cilk_spawn traverseQuadtree(node->se, collisionWorld, lineNode);
 			cilk_sync;
+			TRACE_END(subtree, "traverseQuadtree", "lines", 0);
 		}
 		return;
 	}
+	TRACE_BEGIN(subtree);
 	node->firstQuadtreeLineNode->next = lineNode;
 
 	if (node->nw != NULL) {
-		cilk_spawn traverseQuadtree(node->nw, intersectionEventListReducer, node->lines);
-		cilk_spawn traverseQuadtree(node->ne, intersectionEventListReducer, node->lines);
-		cilk_spawn traverseQuadtree(node->sw, intersectionEventListReducer, node->lines);
-		cilk_spawn traverseQuadtree(node->se, intersectionEventListReducer, node->lines);
+		cilk_spawn traverseQuadtree(node->nw, collisionWorld, node->lines);
+		cilk_spawn traverseQuadtree(node->ne, collisionWorld, node->lines);
+		cilk_spawn traverseQuadtree(node->sw, collisionWorld, node->lines);
+		cilk_spawn traverseQuadtree(node->se, collisionWorld, node->lines);
 	}
 
+	TRACE_BEGIN(lines);
+	HEAT_MAP_BEGIN(&REDUCER_VIEW(collisionWorld->events));
 	LineNode * currentQuadtreeLineNode = node->lines;
 	while (currentQuadtreeLineNode != lineNode) {
 
-		testNewCollisionLineNode(currentQuadtreeLineNode, intersectionEventListReducer);
+		testNewCollisionLineNode(currentQuadtreeLineNode, collisionWorld);
 		currentQuadtreeLineNode = currentQuadtreeLineNode->next;
 	}
+	HEAT_MAP_END(node, &REDUCER_VIEW(collisionWorld->events));
+	TRACE_END(lines, "testNodeLines", "lines", node->numberOfLines);
 	cilk_sync;
 	node->firstQuadtreeLineNode->next = NULL;
+	TRACE_END(subtree, "traverseQuadtree", "lines", node->numberOfLines);
 }
 
-int overlapsRight(Line *line) {
+// A sleeping line has no velocity and is well inside the box, so the walls
+// never touch it.
+int overlapsRight(Line *line, double timeStep) {
+	if (line->asleep) {
+		return 0;
+	}
 	if ((line->p1.x > BOX_XMAX || line->p2.x > BOX_XMAX)
 	        && (line->velocity.x > 0)) {
 	  line->velocity.x = -line->velocity.x;
 
-	  updateLineFuturePoints(line);
+	  updateLineFuturePoints(line, timeStep);
 
 	  return 1;
 	}
 	return 0;
 }
 
-int overlapsLeft(Line *line) {
+int overlapsLeft(Line *line, double timeStep) {
+	if (line->asleep) {
+		return 0;
+	}
 	if ((line->p1.x < BOX_XMIN || line->p2.x < BOX_XMIN)
 	        && (line->velocity.x < 0)) {
 	  line->velocity.x = -line->velocity.x;
 
-	  updateLineFuturePoints(line);
+	  updateLineFuturePoints(line, timeStep);
 
 	  return 1;
 	}
 	return 0;
 }
 
-int overlapsTop(Line *line) {
+int overlapsTop(Line *line, double timeStep) {
+	if (line->asleep) {
+		return 0;
+	}
 	if ((line->p1.y > BOX_YMAX || line->p2.y > BOX_YMAX)
 			&& (line->velocity.y > 0)) {
 	  line->velocity.y = -line->velocity.y;
 
-	  updateLineFuturePoints(line);
+	  updateLineFuturePoints(line, timeStep);
 
 	  return 1;
 	}
 	return 0;
 }
 
-int overlapsBottom(Line *line) {
+int overlapsBottom(Line *line, double timeStep) {
+	if (line->asleep) {
+		return 0;
+	}
 	if ((line->p1.y < BOX_YMIN || line->p2.y < BOX_YMIN)
 							&& (line->velocity.y < 0)) {
 	  line->velocity.y = -line->velocity.y;
 
-	  updateLineFuturePoints(line);
+	  updateLineFuturePoints(line, timeStep);
 
 	  return 1;
 	}
@@ -554,7 +962,7 @@ int overlapsBottom(Line *line) {
 2: south
 3: west
 */
-int traverseQuadtreeSide(Node *node, side_t side) {
+int traverseQuadtreeSide(Node *node, side_t side, double timeStep) {
 	if (node == NULL) {return 0;}
 	int count = 0;
 	int count1 = 0;
@@ -565,41 +973,41 @@ int traverseQuadtreeSide(Node *node, side_t side) {
 			while (currentQuadtreeLineNode != NULL) {
 //			for (int i=0; i < node->numberOfLines; i++) {
 				Line * line = currentQuadtreeLineNode->line;
-				count += overlapsTop(line);
+				count += overlapsTop(line, timeStep);
 				currentQuadtreeLineNode = currentQuadtreeLineNode->next;
 			}
-			count1 = traverseQuadtreeSide(node->nw,NORTH);
-			count2 = traverseQuadtreeSide(node->ne,NORTH);
+			count1 = traverseQuadtreeSide(node->nw, NORTH, timeStep);
+			count2 = traverseQuadtreeSide(node->ne, NORTH, timeStep);
 			break;
 		case EAST:
 			while (currentQuadtreeLineNode != NULL) {
 //			for (int i=0; i < node->numberOfLines; i++) {
 				Line * line = currentQuadtreeLineNode->line;
-				count += overlapsRight(line);
+				count += overlapsRight(line, timeStep);
 				currentQuadtreeLineNode = currentQuadtreeLineNode->next;
 			}
-			count1 = traverseQuadtreeSide(node->ne,EAST);
-			count2 = traverseQuadtreeSide(node->se,EAST);
+			count1 = traverseQuadtreeSide(node->ne, EAST, timeStep);
+			count2 = traverseQuadtreeSide(node->se, EAST, timeStep);
 			break;
 		case SOUTH:
 			while (currentQuadtreeLineNode != NULL) {
 //			for (int i=0; i < node->numberOfLines; i++) {
 				Line * line = currentQuadtreeLineNode->line;
-				count += overlapsBottom(line);
+				count += overlapsBottom(line, timeStep);
 				currentQuadtreeLineNode = currentQuadtreeLineNode->next;
 			}
-			count1 = traverseQuadtreeSide(node->sw,SOUTH);
-			count2 = traverseQuadtreeSide(node->se,SOUTH);
+			count1 = traverseQuadtreeSide(node->sw, SOUTH, timeStep);
+			count2 = traverseQuadtreeSide(node->se, SOUTH, timeStep);
 			break;
 		case WEST:
 			while (currentQuadtreeLineNode != NULL) {
 //			for (int i=0; i < node->numberOfLines; i++) {
 				Line * line = currentQuadtreeLineNode->line;
-				count += overlapsLeft(line);
+				count += overlapsLeft(line, timeStep);
 				currentQuadtreeLineNode = currentQuadtreeLineNode->next;
 			}
-			count1 = traverseQuadtreeSide(node->sw,WEST);
-			count2 = traverseQuadtreeSide(node->nw,WEST);
+			count1 = traverseQuadtreeSide(node->sw, WEST, timeStep);
+			count2 = traverseQuadtreeSide(node->nw, WEST, timeStep);
 			break;
 	}
 	return count + count1 + count2;
@@ -611,7 +1019,7 @@ int traverseQuadtreeSide(Node *node, side_t side) {
  * 2: SE
  * 3: SW
  */
-int traverseQuadtreeCorner(Node *node, quadrant_t corner) {
+int traverseQuadtreeCorner(Node *node, quadrant_t corner, double timeStep) {
 	if (node == NULL) {return 0;}
 	int count = 0;
 	int count1 = 0;
@@ -623,49 +1031,49 @@ int traverseQuadtreeCorner(Node *node, quadrant_t corner) {
 			while (currentQuadtreeLineNode != NULL) {
 //			for (int i=0; i < node->numberOfLines; i++) {
 				Line * line = currentQuadtreeLineNode->line;
-				count += overlapsTop(line);
-				count += overlapsLeft(line);
+				count += overlapsTop(line, timeStep);
+				count += overlapsLeft(line, timeStep);
 				currentQuadtreeLineNode = currentQuadtreeLineNode->next;
 			}
-			count1 = traverseQuadtreeCorner(node->nw,NW);
-			count2 = traverseQuadtreeSide(node->ne,NORTH);
-			count3 = traverseQuadtreeSide(node->sw,WEST);
+			count1 = traverseQuadtreeCorner(node->nw, NW, timeStep);
+			count2 = traverseQuadtreeSide(node->ne, NORTH, timeStep);
+			count3 = traverseQuadtreeSide(node->sw, WEST, timeStep);
 			break;
 		case NE:
 			while (currentQuadtreeLineNode != NULL) {
 //			for (int i=0; i < node->numberOfLines; i++) {
 				Line * line = currentQuadtreeLineNode->line;
-				count += overlapsTop(line);
-				count += overlapsRight(line);
+				count += overlapsTop(line, timeStep);
+				count += overlapsRight(line, timeStep);
 				currentQuadtreeLineNode = currentQuadtreeLineNode->next;
 			}
-			count1 = traverseQuadtreeCorner(node->ne,NE);
-			count2 = traverseQuadtreeSide(node->nw,NORTH);
-			count3 = traverseQuadtreeSide(node->se,EAST);
+			count1 = traverseQuadtreeCorner(node->ne, NE, timeStep);
+			count2 = traverseQuadtreeSide(node->nw, NORTH, timeStep);
+			count3 = traverseQuadtreeSide(node->se, EAST, timeStep);
 			break;
 		case SE:
 			while (currentQuadtreeLineNode != NULL) {
 //			for (int i=0; i < node->numberOfLines; i++) {
 				Line * line = currentQuadtreeLineNode->line;
-				count += overlapsRight(line);
-				count += overlapsBottom(line);
+				count += overlapsRight(line, timeStep);
+				count += overlapsBottom(line, timeStep);
 				currentQuadtreeLineNode = currentQuadtreeLineNode->next;
 			}
-			count1 = traverseQuadtreeCorner(node->se,SE);
-			count2 = traverseQuadtreeSide(node->sw,SOUTH);
-			count3 = traverseQuadtreeSide(node->ne,EAST);
+			count1 = traverseQuadtreeCorner(node->se, SE, timeStep);
+			count2 = traverseQuadtreeSide(node->sw, SOUTH, timeStep);
+			count3 = traverseQuadtreeSide(node->ne, EAST, timeStep);
 			break;
 		case SW:
 			while (currentQuadtreeLineNode != NULL) {
 //			for (int i=0; i < node->numberOfLines; i++) {
 				Line * line = currentQuadtreeLineNode->line;
-				count += overlapsBottom(line);
-				count += overlapsLeft(line);
+				count += overlapsBottom(line, timeStep);
+				count += overlapsLeft(line, timeStep);
 				currentQuadtreeLineNode = currentQuadtreeLineNode->next;
 			}
-			count1 = traverseQuadtreeCorner(node->sw,SW);
-			count2 = traverseQuadtreeSide(node->se,SOUTH);
-			count3 = traverseQuadtreeSide(node->nw,WEST);
+			count1 = traverseQuadtreeCorner(node->sw, SW, timeStep);
+			count2 = traverseQuadtreeSide(node->se, SOUTH, timeStep);
+			count3 = traverseQuadtreeSide(node->nw, WEST, timeStep);
 			break;
 		default:
 			break;
@@ -674,21 +1082,21 @@ int traverseQuadtreeCorner(Node *node, quadrant_t corner) {
 	return count + count1 + count2 + count3;
 }
 
-int getWallCollisions (Node * root) {
+int getWallCollisions (Node * root, double timeStep) {
 	int countRoot = 0;
 	LineNode * currentQuadtreeLineNode = root->lines;
 	while (currentQuadtreeLineNode != NULL) {
 		Line * line = currentQuadtreeLineNode->line;
-		countRoot += overlapsTop(line);
-		countRoot += overlapsRight(line);
-		countRoot += overlapsBottom(line);
-		countRoot += overlapsLeft(line);
+		countRoot += overlapsTop(line, timeStep);
+		countRoot += overlapsRight(line, timeStep);
+		countRoot += overlapsBottom(line, timeStep);
+		countRoot += overlapsLeft(line, timeStep);
 		currentQuadtreeLineNode = currentQuadtreeLineNode->next;
 	}
-	int count1 = traverseQuadtreeCorner(root->nw, NW);
-	int count2 = traverseQuadtreeCorner(root->ne, NE);
-	int count3 = traverseQuadtreeCorner(root->se, SE);
-	int count4 = traverseQuadtreeCorner(root->sw, SW);
+	int count1 = traverseQuadtreeCorner(root->nw, NW, timeStep);
+	int count2 = traverseQuadtreeCorner(root->ne, NE, timeStep);
+	int count3 = traverseQuadtreeCorner(root->se, SE, timeStep);
+	int count4 = traverseQuadtreeCorner(root->sw, SW, timeStep);
 	return countRoot + count1 + count2 + count3 + count4;
 	return countRoot;
 }
@@ -13,8 +13,6 @@
 #include "./CollisionWorld.h"
 #include "./IntersectionEventList.h"
 
-struct quadtree_node * globalQuadtree;
-
 struct quadtree_node{
 
 	struct quadtree_node *nw;
@@ -39,7 +37,17 @@ struct quadtree_node{
 	struct LinkedLineNode * lines;//pointer to the last LinkedLineNode
 	int numberOfLines;
 
-} quadtree_node_t;
+#ifdef HEAT_MAP
+	// traverseQuadtree's work on this node's lines over the run, and the
+	// frames it had lines in (see HeatMap.h)
+	uint64_t pairTests;
+	uint64_t narrowPhaseTests;
+	uint64_t lineFrames;
+	unsigned int frames;
+	double seconds;
+#endif
+
+};
 typedef struct quadtree_node Node;
 
 
@@ -47,7 +55,7 @@ typedef struct quadtree_node Node;
 struct LinkedLineNode {
 	struct LinkedLineNode *next;
 	Line * line;
-} LinkedLineNode;
+};
 typedef struct LinkedLineNode LineNode;
 
 
@@ -60,23 +68,30 @@ void addLine(Node* node, Line * line);
 void freeNode(Node * node);
 LineNode * createLineNode(LineNode * lineNode, Line * line);
 
+// The functions that test pairs take the world that owns the tree, for its
+// time step, frame and events; the rest take only the parameter they use.
 Node * instantiateRoot(CollisionWorld * collisionWorld);
-void traverseQuadtree(Node *node,
-		IntersectionEventListReducer * intersectionEventListReducer,
+Node * bulkBuildRoot(CollisionWorld * collisionWorld);
+Node * instantiateStaticIndex(CollisionWorld * collisionWorld);
+void queryStaticIndex(Node * node, Line * line,
+		CollisionWorld * collisionWorld);
+void traverseQuadtree(Node *node, CollisionWorld * collisionWorld,
 		LineNode * lineNode);
-int getWallCollisions (Node * root);
+int getWallCollisions (Node * root, double timeStep);
 
+void insertQuadtreeLine(Node * root, Line * line, unsigned int maxLines);
+void removeQuadtreeLine(Line * line);
 void addQuadtreeLineNode(Node * node, LineNode * lineNode);
 void freeQuadtreeLineNode(LineNode * lineNode);
 void reAddQuadtreeLineNode(Node * node, LineNode * lineNode);
 void insertLineNodeUpwardDuringUpdate(Node * node, LineNode * lineNode);
 void insertLineNodeDownwardDuringUpdate(Node * node, LineNode * lineNode);
-void updateNode(Node * root);
-void attachBuffers(Node * node);
+void updateNode(Node * root, double timeStep);
+void attachBuffers(Node * node, unsigned int maxLines);
 void addToBuffer(Node * node, LineNode * lineNode);
 LineNode * addLineNode(Line * line, LineNode * lineNode,
-		IntersectionEventListReducer * intersectionEventListReducer);
+		CollisionWorld * collisionWorld);
 void testNewCollisionLineNode(LineNode * lineNode,
-		IntersectionEventListReducer * intersectionEventListReducer);
+		CollisionWorld * collisionWorld);
 
 #endif /* QUADTREE_H_ */
@@ -0,0 +1,105 @@
+/*
+ * QuadtreeStats.c -- shape statistics of the collision quadtree
+ */
+
+#include "./QuadtreeStats.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+static unsigned int linesPerNodeBucket(unsigned int lines) {
+  unsigned int bucket = 0;
+  while (lines != 0 && bucket < QUADTREE_STATS_BUCKETS - 1) {
+    lines >>= 1;
+    bucket++;
+  }
+  return bucket;
+}
+
+static void measureNode(Node * node, unsigned int level,
+                        uint64_t ancestorLines,
+                        QuadtreeStats * stats) {
+  assert(node->bufferLineCount == 0);
+  const unsigned int lines = node->numberOfLines;
+  const int isLeaf = node->nw == NULL;
+  QuadtreeLevelStats * levelStats =
+      &stats->levels[level < QUADTREE_STATS_LEVELS ? level
+                                                   : QUADTREE_STATS_LEVELS - 1];
+
+  if (level > stats->depth) {
+    stats->depth = level;
+  }
+  stats->nodes++;
+  stats->lines += lines;
+  stats->linesPerNode[linesPerNodeBucket(lines)]++;
+  stats->candidatePairs += (uint64_t) lines * (lines - 1) / 2
+      + lines * ancestorLines;
+  if (lines > stats->maxLinesPerNode) {
+    stats->maxLinesPerNode = lines;
+  }
+  levelStats->nodes++;
+  levelStats->lines += lines;
+  if (lines > levelStats->maxLinesPerNode) {
+    levelStats->maxLinesPerNode = lines;
+  }
+
+  if (isLeaf) {
+    stats->leaves++;
+    stats->emptyLeaves += lines == 0;
+    levelStats->leaves++;
+    return;
+  }
+  stats->internalLines += lines;
+  levelStats->internalLines += lines;
+  measureNode(node->nw, level + 1, ancestorLines + lines, stats);
+  measureNode(node->ne, level + 1, ancestorLines + lines, stats);
+  measureNode(node->sw, level + 1, ancestorLines + lines, stats);
+  measureNode(node->se, level + 1, ancestorLines + lines, stats);
+}
+
+void getQuadtreeStats(Node * root, QuadtreeStats * stats) {
+  memset(stats, 0, sizeof(QuadtreeStats));
+  if (root != NULL) {
+    measureNode(root, 0, 0, stats);
+  }
+}
+
+void printQuadtreeStats(const QuadtreeStats * stats) {
+  printf("Quadtree: depth %u, %u nodes (%u leaves, %u empty), %u lines, "
+         "%u in internal nodes (%.1f%%), max %u per node, "
+         "%" PRIu64 " candidate pairs\n",
+         stats->depth, stats->nodes, stats->leaves, stats->emptyLeaves,
+         stats->lines, stats->internalLines,
+         stats->lines ? 100.0 * stats->internalLines / stats->lines : 0.0,
+         stats->maxLinesPerNode, stats->candidatePairs);
+  printf("  %5s %8s %8s %10s %10s %10s %8s\n", "level", "nodes", "leaves",
+         "lines", "internal", "lines/node", "max");
+  const unsigned int levels = stats->depth < QUADTREE_STATS_LEVELS
+      ? stats->depth + 1 : QUADTREE_STATS_LEVELS;
+  for (unsigned int level = 0; level < levels; level++) {
+    const QuadtreeLevelStats * levelStats = &stats->levels[level];
+    printf("  %4u%s %8u %8u %10u %10u %10.1f %8u\n", level,
+           level == QUADTREE_STATS_LEVELS - 1 ? "+" : " ", levelStats->nodes,
+           levelStats->leaves, levelStats->lines, levelStats->internalLines,
+           levelStats->nodes
+               ? (double) levelStats->lines / levelStats->nodes : 0.0,
+           levelStats->maxLinesPerNode);
+  }
+  printf("  lines per node:");
+  for (unsigned int bucket = 0; bucket < QUADTREE_STATS_BUCKETS; bucket++) {
+    if (stats->linesPerNode[bucket] == 0) {
+      continue;
+    }
+    if (bucket <= 1) {
+      printf(" [%u] %u", bucket, stats->linesPerNode[bucket]);
+    } else if (bucket == QUADTREE_STATS_BUCKETS - 1) {
+      printf(" [%u+] %u", 1u << (bucket - 1), stats->linesPerNode[bucket]);
+    } else {
+      printf(" [%u-%u] %u", 1u << (bucket - 1), (1u << bucket) - 1,
+             stats->linesPerNode[bucket]);
+    }
+  }
+  printf("\n");
+}
@@ -0,0 +1,57 @@
+/*
+ * QuadtreeStats.h -- shape statistics of the collision quadtree
+ *
+ * Reports how the lines of a quadtree are spread over its nodes and levels,
+ * how many lines are held by internal nodes (every one of which is tested
+ * against every line below it), and how many candidate pairs that makes for
+ * traverseQuadtree.  Together with the per-frame prefilter, intersect() and
+ * event counters of the CollisionWorld, this explains where a scene's
+ * collision detection time goes.
+ */
+
+#ifndef QUADTREESTATS_H_
+#define QUADTREESTATS_H_
+
+#include "./Quadtree.h"
+
+// Levels reported separately; deeper levels are counted in the last one.
+#define QUADTREE_STATS_LEVELS 24
+// Buckets of the lines-per-node histogram: 0, 1, 2-3, 4-7, ..., and
+// 2^(QUADTREE_STATS_BUCKETS - 2) or more.
+#define QUADTREE_STATS_BUCKETS 12
+
+typedef struct {
+  unsigned int nodes;
+  unsigned int leaves;
+  unsigned int lines;
+  unsigned int internalLines;  // lines held by internal nodes
+  unsigned int maxLinesPerNode;
+} QuadtreeLevelStats;
+
+typedef struct {
+  // Deepest level with a node; the root is level 0.
+  unsigned int depth;
+  unsigned int nodes;
+  unsigned int leaves;
+  unsigned int lines;
+  unsigned int internalLines;
+  unsigned int maxLinesPerNode;
+  unsigned int emptyLeaves;
+
+  // Pairs traverseQuadtree hands to the box prefilter: every pair of lines
+  // in a node, and every line of a node with every line of its ancestors.
+  uint64_t candidatePairs;
+
+  QuadtreeLevelStats levels[QUADTREE_STATS_LEVELS];
+  // Nodes by number of lines, in power-of-two buckets.
+  unsigned int linesPerNode[QUADTREE_STATS_BUCKETS];
+} QuadtreeStats;
+
+// Measures the quadtree under root.  The buffers must be empty, as they are
+// between frames.
+void getQuadtreeStats(Node * root, QuadtreeStats * stats);
+
+// Prints stats as a per-level table and a lines-per-node histogram.
+void printQuadtreeStats(const QuadtreeStats * stats);
+
+#endif  // QUADTREESTATS_H_
@@ -0,0 +1,207 @@
+/*
+ * Rasterizer.c -- draw a CollisionWorld's lines into an image, without X11
+ */
+
+#include "./Rasterizer.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cilk/cilk.h>
+
+#include "./Line.h"
+
+// Pixels a line's drawn pixels may lie from the line itself: under one
+// from rounding its endpoints down, and a half from rounding along it.
+#define RASTERIZER_TILE_MARGIN 2
+
+// The colours X11 names "dark red" and "gray", as drawLineSegments uses.
+static const unsigned char colours[2][3] = {
+  [RED] = {139, 0, 0},
+  [GRAY] = {190, 190, 190}
+};
+
+// The pixels [x0, x1) by [y0, y1) of a tile.
+typedef struct {
+  int x0;
+  int x1;
+  int y0;
+  int y1;
+} Tile;
+
+static Tile getTile(const Rasterizer *rasterizer, unsigned int tile) {
+  Tile t;
+  t.x0 = (tile % rasterizer->numTilesX) * RASTERIZER_TILE_SIZE;
+  t.y0 = (tile / rasterizer->numTilesX) * RASTERIZER_TILE_SIZE;
+  t.x1 = t.x0 + RASTERIZER_TILE_SIZE < rasterizer->width
+      ? t.x0 + RASTERIZER_TILE_SIZE : rasterizer->width;
+  t.y1 = t.y0 + RASTERIZER_TILE_SIZE < rasterizer->height
+      ? t.y0 + RASTERIZER_TILE_SIZE : rasterizer->height;
+  return t;
+}
+
+static inline double boxToPixelX(const Rasterizer *rasterizer, double x) {
+  return (x - BOX_XMIN) / ((double) BOX_XMAX - BOX_XMIN) * rasterizer->width;
+}
+
+static inline double boxToPixelY(const Rasterizer *rasterizer, double y) {
+  return (y - BOX_YMIN) / ((double) BOX_YMAX - BOX_YMIN) * rasterizer->height;
+}
+
+static inline double pixelToBoxX(const Rasterizer *rasterizer, double x) {
+  return x / rasterizer->width * ((double) BOX_XMAX - BOX_XMIN) + BOX_XMIN;
+}
+
+static inline double pixelToBoxY(const Rasterizer *rasterizer, double y) {
+  return y / rasterizer->height * ((double) BOX_YMAX - BOX_YMIN) + BOX_YMIN;
+}
+
+Rasterizer* Rasterizer_new(unsigned int width, unsigned int height) {
+  Rasterizer *rasterizer = malloc(sizeof(Rasterizer));
+  rasterizer->width = width;
+  rasterizer->height = height;
+  rasterizer->pixels = calloc((size_t) width * height, 3);
+  rasterizer->numTilesX = (width + RASTERIZER_TILE_SIZE - 1)
+      / RASTERIZER_TILE_SIZE;
+  rasterizer->numTilesY = (height + RASTERIZER_TILE_SIZE - 1)
+      / RASTERIZER_TILE_SIZE;
+
+  const unsigned int numTiles = rasterizer->numTilesX * rasterizer->numTilesY;
+  rasterizer->tileQueries = malloc(numTiles * sizeof(SpatialQuery));
+  for (unsigned int i = 0; i < numTiles; i++) {
+    const Tile tile = getTile(rasterizer, i);
+    SpatialQuery *query = &rasterizer->tileQueries[i];
+    query->kind = QUERY_RANGE;
+    query->a.x = pixelToBoxX(rasterizer, tile.x0 - RASTERIZER_TILE_MARGIN);
+    query->a.y = pixelToBoxY(rasterizer, tile.y0 - RASTERIZER_TILE_MARGIN);
+    query->b.x = pixelToBoxX(rasterizer, tile.x1 + RASTERIZER_TILE_MARGIN);
+    query->b.y = pixelToBoxY(rasterizer, tile.y1 + RASTERIZER_TILE_MARGIN);
+    query->radius = 0;
+    query->k = 0;
+  }
+  return rasterizer;
+}
+
+void Rasterizer_delete(Rasterizer *rasterizer) {
+  free(rasterizer->tileQueries);
+  free(rasterizer->pixels);
+  free(rasterizer);
+}
+
+static void clearTile(Rasterizer *rasterizer, const Tile *tile) {
+  for (int y = tile->y0; y < tile->y1; y++) {
+    memset(&rasterizer->pixels[3 * ((size_t) y * rasterizer->width + tile->x0)],
+           0, 3 * (tile->x1 - tile->x0));
+  }
+}
+
+static inline void setPixel(Rasterizer *rasterizer, int x, int y,
+                            const unsigned char *colour) {
+  unsigned char *pixel =
+      &rasterizer->pixels[3 * ((size_t) y * rasterizer->width + x)];
+  pixel[0] = colour[0];
+  pixel[1] = colour[1];
+  pixel[2] = colour[2];
+}
+
+// Draw the part of line inside tile.  The line steps one pixel at a time
+// along its longer axis from its rounded-down endpoints, and the other
+// coordinate of each pixel is rounded from the endpoints alone.
+static void drawLine(Rasterizer *rasterizer, const Tile *tile,
+                     const Line *line) {
+  int x0 = (int) floor(boxToPixelX(rasterizer, line->p1.x));
+  int y0 = (int) floor(boxToPixelY(rasterizer, line->p1.y));
+  int x1 = (int) floor(boxToPixelX(rasterizer, line->p2.x));
+  int y1 = (int) floor(boxToPixelY(rasterizer, line->p2.y));
+  const unsigned char *colour = colours[line->color];
+
+  if (abs(x1 - x0) >= abs(y1 - y0)) {
+    if (x1 < x0) {
+      int swap = x0; x0 = x1; x1 = swap;
+      swap = y0; y0 = y1; y1 = swap;
+    }
+    const double slope = x1 > x0 ? (double) (y1 - y0) / (x1 - x0) : 0;
+    const int from = x0 > tile->x0 ? x0 : tile->x0;
+    const int to = x1 < tile->x1 - 1 ? x1 : tile->x1 - 1;
+    for (int x = from; x <= to; x++) {
+      const int y = y0 + (int) floor((x - x0) * slope + 0.5);
+      if (y >= tile->y0 && y < tile->y1) {
+        setPixel(rasterizer, x, y, colour);
+      }
+    }
+  } else {
+    if (y1 < y0) {
+      int swap = x0; x0 = x1; x1 = swap;
+      swap = y0; y0 = y1; y1 = swap;
+    }
+    const double slope = (double) (x1 - x0) / (y1 - y0);
+    const int from = y0 > tile->y0 ? y0 : tile->y0;
+    const int to = y1 < tile->y1 - 1 ? y1 : tile->y1 - 1;
+    for (int y = from; y <= to; y++) {
+      const int x = x0 + (int) floor((y - y0) * slope + 0.5);
+      if (x >= tile->x0 && x < tile->x1) {
+        setPixel(rasterizer, x, y, colour);
+      }
+    }
+  }
+}
+
+// Draw lines[0 ... numLines - 1] into tile: the red ones, then the gray
+// ones over them, as drawLineSegments does.
+static void drawTile(Rasterizer *rasterizer, const Tile *tile,
+                     Line *const *lines, const SpatialMatch *matches,
+                     unsigned int numLines) {
+  clearTile(rasterizer, tile);
+  for (Color color = RED; color <= GRAY; color++) {
+    for (unsigned int i = 0; i < numLines; i++) {
+      const Line *line = lines != NULL ? lines[i] : matches[i].line;
+      if (line->color == color) {
+        drawLine(rasterizer, tile, line);
+      }
+    }
+  }
+}
+
+void Rasterizer_draw(Rasterizer *rasterizer, CollisionWorld *collisionWorld) {
+  const unsigned int numTiles = rasterizer->numTilesX * rasterizer->numTilesY;
+  SpatialQueryResults results;
+  SpatialQuery_batch(collisionWorld, rasterizer->tileQueries, numTiles,
+                     &results);
+  cilk_for (unsigned int i = 0; i < numTiles; i++) {
+    const Tile tile = getTile(rasterizer, i);
+    drawTile(rasterizer, &tile, NULL, &results.matches[results.first[i]],
+             results.first[i + 1] - results.first[i]);
+  }
+  SpatialQueryResults_free(&results);
+}
+
+void Rasterizer_drawBruteForce(Rasterizer *rasterizer,
+                               CollisionWorld *collisionWorld) {
+  const unsigned int numTiles = rasterizer->numTilesX * rasterizer->numTilesY;
+  cilk_for (unsigned int i = 0; i < numTiles; i++) {
+    const Tile tile = getTile(rasterizer, i);
+    drawTile(rasterizer, &tile, collisionWorld->lines, NULL,
+             collisionWorld->numOfLines);
+  }
+}
+
+bool Rasterizer_writePPM(const Rasterizer *rasterizer, const char *path) {
+  FILE *file = fopen(path, "wb");
+  if (file == NULL) {
+    perror(path);
+    return false;
+  }
+  fprintf(file, "P6\n%u %u\n255\n", rasterizer->width, rasterizer->height);
+  fwrite(rasterizer->pixels, 3, (size_t) rasterizer->width * rasterizer->height,
+         file);
+
+  bool ok = !ferror(file);
+  if (fclose(file) != 0) {
+    ok = false;
+  }
+  if (!ok) {
+    perror(path);
+  }
+  return ok;
+}
@@ -0,0 +1,56 @@
+/*
+ * Rasterizer.h -- draw a CollisionWorld's lines into an image, without X11
+ *
+ * Renders the picture drawLineSegments shows, dark red lines with gray
+ * ones over them on black, into an RGB framebuffer in memory, so frames
+ * can be dumped on machines without a display.  The image is cut into
+ * tiles drawn in parallel; each tile asks SpatialQuery for the lines
+ * touching it, slightly enlarged, and draws only those, clipped to itself.
+ * A line's pixels don't depend on the tile drawing them, so the image is
+ * the same however it is cut.
+ *
+ * Like SpatialQuery, drawing reads the quadtrees, so it must run between
+ * frames, never during CollisionWorld_updateLines.
+ */
+
+#ifndef RASTERIZER_H_
+#define RASTERIZER_H_
+
+#include <stdbool.h>
+
+#include "./CollisionWorld.h"
+#include "./SpatialQuery.h"
+
+// Tiles are this many pixels square, except at the right and bottom edges.
+#define RASTERIZER_TILE_SIZE 64
+
+typedef struct {
+  unsigned int width;
+  unsigned int height;
+  // width * height pixels of red, green and blue, row after row from the
+  // top, as in a PPM file.
+  unsigned char *pixels;
+  unsigned int numTilesX;
+  unsigned int numTilesY;
+  // One range query per tile, row after row.
+  SpatialQuery *tileQueries;
+} Rasterizer;
+
+// A rasterizer for width by height images of the whole box.
+Rasterizer* Rasterizer_new(unsigned int width, unsigned int height);
+
+void Rasterizer_delete(Rasterizer *rasterizer);
+
+// Draw collisionWorld's lines into the framebuffer, replacing its contents.
+void Rasterizer_draw(Rasterizer *rasterizer, CollisionWorld *collisionWorld);
+
+// The same, with every tile clipping every line rather than the lines the
+// quadtree finds for it, to check and time the culling against.
+void Rasterizer_drawBruteForce(Rasterizer *rasterizer,
+                               CollisionWorld *collisionWorld);
+
+// Write the framebuffer to path as a binary PPM.  Returns false, after
+// printing why, if it can't.
+bool Rasterizer_writePPM(const Rasterizer *rasterizer, const char *path);
+
+#endif  // RASTERIZER_H_
@@ -0,0 +1,29 @@
+/*
+ * SceneConvert.c -- convert a line.in text scene to the binary scene format
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "./LineDemo.h"
+#include "./SceneFile.h"
+
+int main(int argc, char *argv[]) {
+  if (argc != 3) {
+    printf("Usage: %s <input line.in> <output scene>\n", argv[0]);
+    exit(-1);
+  }
+
+  LineDemo *lineDemo = LineDemo_new();
+  LineDemo_setInputFile(argv[1]);
+  LineDemo_createLines(lineDemo);
+
+  if (!SceneFile_write(argv[2], lineDemo->collisionWorld)) {
+    LineDemo_delete(lineDemo);
+    return 1;
+  }
+  printf("Wrote %u lines to %s\n", LineDemo_getNumOfLines(lineDemo), argv[2]);
+
+  LineDemo_delete(lineDemo);
+  return 0;
+}
@@ -0,0 +1,152 @@
+/*
+ * SceneFile.c -- versioned binary scene format
+ */
+
+#include "./SceneFile.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cilk/cilk.h>
+
+static const char SCENE_FILE_MAGIC[8] = {'L', 'I', 'N', 'E', 'S', 'C', 'N', '\0'};
+
+bool SceneFile_isBinary(const char *path) {
+  FILE *fin = fopen(path, "rb");
+  if (fin == NULL) {
+    return false;
+  }
+  char magic[sizeof(SCENE_FILE_MAGIC)];
+  bool isBinary = fread(magic, sizeof(magic), 1, fin) == 1
+      && memcmp(magic, SCENE_FILE_MAGIC, sizeof(magic)) == 0;
+  fclose(fin);
+  return isBinary;
+}
+
+CollisionWorld* SceneFile_load(const char *path) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    perror(path);
+    return NULL;
+  }
+  struct stat status;
+  if (fstat(fd, &status) != 0) {
+    perror(path);
+    close(fd);
+    return NULL;
+  }
+  size_t size = status.st_size;
+  if (size < sizeof(SceneFileHeader)) {
+    fprintf(stderr, "%s: truncated scene header\n", path);
+    close(fd);
+    return NULL;
+  }
+  void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    perror(path);
+    return NULL;
+  }
+  madvise(map, size, MADV_SEQUENTIAL);
+
+  const SceneFileHeader *header = map;
+  if (memcmp(header->magic, SCENE_FILE_MAGIC, sizeof(SCENE_FILE_MAGIC)) != 0
+      || header->version != SCENE_FILE_VERSION
+      || header->recordSize != sizeof(SceneRecord)) {
+    fprintf(stderr, "%s: not a version %d scene file\n", path,
+            SCENE_FILE_VERSION);
+    munmap(map, size);
+    return NULL;
+  }
+  const uint64_t numOfLines = header->numOfLines;
+  if (numOfLines == 0 || numOfLines > UINT32_MAX
+      || (size - sizeof(SceneFileHeader)) / sizeof(SceneRecord) < numOfLines) {
+    fprintf(stderr, "%s: scene holds %llu lines but the file is %zu bytes\n",
+            path, (unsigned long long) numOfLines, size);
+    munmap(map, size);
+    return NULL;
+  }
+
+  // a scene holds red or gray, moving or static lines, and nothing else
+  const SceneRecord *records = (const SceneRecord *) (header + 1);
+  for (uint64_t i = 0; i < numOfLines; i++) {
+    if ((records[i].color != RED && records[i].color != GRAY)
+        || (records[i].kind != DYNAMIC_LINE
+            && records[i].kind != STATIC_LINE)) {
+      fprintf(stderr, "%s: record %llu has color %u and kind %u\n", path,
+              (unsigned long long) i, records[i].color, records[i].kind);
+      munmap(map, size);
+      return NULL;
+    }
+  }
+
+  CollisionWorld *collisionWorld = CollisionWorld_new(numOfLines);
+  Line *lines = CollisionWorld_reserveLines(collisionWorld, numOfLines);
+  cilk_for (unsigned int i = 0; i < numOfLines; i++) {
+    const SceneRecord *record = &records[i];
+    initLine(&lines[i], record->p1, record->p2, record->velocity,
+             (Color) record->color, (LineKind) record->kind, i,
+             collisionWorld->timeStep);
+  }
+  CollisionWorld_commitLines(collisionWorld, lines, numOfLines);
+
+  munmap(map, size);
+  return collisionWorld;
+}
+
+FILE* SceneFile_create(const char *path, uint64_t numOfLines) {
+  FILE *fout = fopen(path, "wb");
+  if (fout == NULL) {
+    perror(path);
+    return NULL;
+  }
+
+  SceneFileHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, SCENE_FILE_MAGIC, sizeof(SCENE_FILE_MAGIC));
+  header.version = SCENE_FILE_VERSION;
+  header.recordSize = sizeof(SceneRecord);
+  header.numOfLines = numOfLines;
+  if (fwrite(&header, sizeof(header), 1, fout) != 1) {
+    perror(path);
+    fclose(fout);
+    return NULL;
+  }
+  return fout;
+}
+
+bool SceneFile_writeRecord(FILE *fout, const SceneRecord *record) {
+  return fwrite(record, sizeof(SceneRecord), 1, fout) == 1;
+}
+
+bool SceneFile_write(const char *path, CollisionWorld *collisionWorld) {
+  FILE *fout = SceneFile_create(path, collisionWorld->numOfLines);
+  if (fout == NULL) {
+    return false;
+  }
+
+  bool ok = true;
+  for (unsigned int i = 0; ok && i < collisionWorld->numOfLines; i++) {
+    Line *line = collisionWorld->lines[i];
+    SceneRecord record;
+    memset(&record, 0, sizeof(record));
+    record.p1 = line->p1;
+    record.p2 = line->p2;
+    record.velocity = line->velocity;
+    record.color = line->color;
+    record.kind = line->kind;
+    ok = SceneFile_writeRecord(fout, &record);
+  }
+
+  if (fclose(fout) != 0) {
+    ok = false;
+  }
+  if (!ok) {
+    perror(path);
+  }
+  return ok;
+}
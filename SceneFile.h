@@ -0,0 +1,62 @@
+/*
+ * SceneFile.h -- versioned binary scene format
+ *
+ * A binary scene is a SceneFileHeader followed by numOfLines SceneRecords,
+ * already in box coordinates, in the world's lines[] order.  Ids aren't
+ * stored: the loader numbers the lines by their position in the file.  The
+ * file is mapped and the records are turned into lines in parallel, with
+ * no text parsing.  Fields are stored in native byte order.
+ */
+
+#ifndef SCENEFILE_H_
+#define SCENEFILE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "./CollisionWorld.h"
+#include "./Line.h"
+
+#define SCENE_FILE_VERSION 1
+
+struct SceneFileHeader {
+  char magic[8];        // SCENE_FILE_MAGIC
+  uint32_t version;     // SCENE_FILE_VERSION
+  uint32_t recordSize;  // sizeof(SceneRecord)
+  uint64_t numOfLines;
+};
+typedef struct SceneFileHeader SceneFileHeader;
+
+// One line, in box coordinates.
+struct SceneRecord {
+  Vec p1;
+  Vec p2;
+  Vec velocity;
+  uint32_t color;  // Color
+  uint32_t kind;   // LineKind
+};
+typedef struct SceneRecord SceneRecord;
+
+// Returns whether the file at path starts with the binary scene magic.
+bool SceneFile_isBinary(const char *path);
+
+// Map a binary scene and build a CollisionWorld holding its lines.
+// Returns NULL, after printing why, if the file is not a valid scene or a
+// record has a colour or kind that isn't RED or GRAY, DYNAMIC_LINE or
+// STATIC_LINE.
+CollisionWorld* SceneFile_load(const char *path);
+
+// Write the lines of collisionWorld as a binary scene.
+// Returns false, after printing why, on failure.
+bool SceneFile_write(const char *path, CollisionWorld *collisionWorld);
+
+// Create a binary scene of numOfLines records at path and write its header;
+// the records follow with SceneFile_writeRecord.  Returns NULL, after
+// printing why, on failure.
+FILE* SceneFile_create(const char *path, uint64_t numOfLines);
+
+// Append one record to a scene started by SceneFile_create.
+bool SceneFile_writeRecord(FILE *fout, const SceneRecord *record);
+
+#endif  // SCENEFILE_H_
@@ -0,0 +1,401 @@
+/*
+ * SceneGen.c -- procedural scene generator for benchmark inputs
+ *
+ * Writes a scene in the line.in text format or the binary scene format.
+ * Every random choice comes from one splitmix64 stream seeded by -s, so a
+ * seed and a set of options always give the same scene, in either format.
+ * Coordinates are rounded to the six decimals the text format keeps before
+ * the binary scene converts them, so both formats load to the same lines.
+ */
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "./Line.h"
+#include "./SceneFile.h"
+
+// Midline levels a straddling line may be placed on; level 0 is the root.
+#define STRADDLE_LEVELS 6
+// Placement attempts per line before the scene is declared too dense.
+#define MAX_PLACEMENT_ATTEMPTS 1000
+// Distance in pixels between a line and the window edges.
+#define EDGE_MARGIN 1.0
+
+typedef enum {UNIFORM_DENSITY, GRADIENT_DENSITY, CENTER_DENSITY} DensityProfile;
+
+typedef struct {
+  unsigned int numOfLines;
+  uint64_t seed;
+  DensityProfile density;
+  unsigned int numOfClusters;
+  double clusterFraction;   // of the lines placed around cluster centers
+  double clusterRadius;     // standard deviation, in pixels
+  double length;            // mean, in pixels
+  double lengthSpread;      // lengths are uniform in length * (1 +- spread)
+  double speed;             // mean, in pixels per time unit
+  double speedSpread;       // speeds are uniform in speed * (1 +- spread)
+  double straddleFraction;  // of the lines centered on a quadtree midline
+  double staticFraction;    // of the lines that are static
+  double grayFraction;      // of the lines drawn gray
+  bool allowOverlaps;
+  bool binary;
+} SceneGenOptions;
+
+// A generated line, in window coordinates.
+typedef struct {
+  double x1, y1, x2, y2;
+  double vx, vy;
+  bool isGray;
+  bool isStatic;
+} GeneratedLine;
+
+// splitmix64
+static uint64_t randomState;
+
+static uint64_t randomNext() {
+  uint64_t z = (randomState += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+// Uniform in [0, 1).
+static double randomUniform() {
+  return (randomNext() >> 11) * 0x1.0p-53;
+}
+
+static double randomRange(double low, double high) {
+  return low + (high - low) * randomUniform();
+}
+
+static double randomGaussian() {
+  double u = 1.0 - randomUniform();
+  return sqrt(-2.0 * log(u)) * cos(2.0 * M_PI * randomUniform());
+}
+
+// Rounds to the precision of the text format.
+static double quantize(double value) {
+  return round(value * 1e6) / 1e6;
+}
+
+static void pickCenter(const SceneGenOptions *options, const double *clusters,
+                       double *x, double *y) {
+  if (options->numOfClusters > 0
+      && randomUniform() < options->clusterFraction) {
+    unsigned int cluster = randomNext() % options->numOfClusters;
+    *x = clusters[2 * cluster] + options->clusterRadius * randomGaussian();
+    *y = clusters[2 * cluster + 1] + options->clusterRadius * randomGaussian();
+    return;
+  }
+  switch (options->density) {
+    case GRADIENT_DENSITY:
+      // density grows linearly from the left edge to the right edge
+      *x = WINDOW_WIDTH * sqrt(randomUniform());
+      *y = WINDOW_HEIGHT * randomUniform();
+      break;
+    case CENTER_DENSITY:
+      *x = WINDOW_WIDTH * (0.5 + randomGaussian() / 6);
+      *y = WINDOW_HEIGHT * (0.5 + randomGaussian() / 6);
+      break;
+    default:
+      *x = WINDOW_WIDTH * randomUniform();
+      *y = WINDOW_HEIGHT * randomUniform();
+      break;
+  }
+}
+
+// Moves (x, y) onto a vertical or horizontal midline of the quadtree cell
+// containing it, at a random level.
+static void snapToMidline(double *x, double *y) {
+  double cells = 1 << (randomNext() % STRADDLE_LEVELS);
+  if (randomNext() & 1) {
+    double width = WINDOW_WIDTH / cells;
+    *x = (floor(*x / width) + 0.5) * width;
+  } else {
+    double height = WINDOW_HEIGHT / cells;
+    *y = (floor(*y / height) + 0.5) * height;
+  }
+}
+
+static inline double orientation(double ax, double ay, double bx, double by,
+                                 double cx, double cy) {
+  return (bx - ax) * (cy - ay) - (by - ay) * (cx - ax);
+}
+
+// Conservative: touching segments count as intersecting.
+static bool segmentsIntersect(const GeneratedLine *a, const GeneratedLine *b) {
+  double d1 = orientation(a->x1, a->y1, a->x2, a->y2, b->x1, b->y1);
+  double d2 = orientation(a->x1, a->y1, a->x2, a->y2, b->x2, b->y2);
+  double d3 = orientation(b->x1, b->y1, b->x2, b->y2, a->x1, a->y1);
+  double d4 = orientation(b->x1, b->y1, b->x2, b->y2, a->x2, a->y2);
+  if (((d1 > 0 && d2 > 0) || (d1 < 0 && d2 < 0))
+      || ((d3 > 0 && d4 > 0) || (d3 < 0 && d4 < 0))) {
+    return false;
+  }
+  // collinear: compare the bounding boxes
+  return fmin(a->x1, a->x2) <= fmax(b->x1, b->x2)
+      && fmin(b->x1, b->x2) <= fmax(a->x1, a->x2)
+      && fmin(a->y1, a->y2) <= fmax(b->y1, b->y2)
+      && fmin(b->y1, b->y2) <= fmax(a->y1, a->y2);
+}
+
+// Uniform grid over the window with cells at least as large as the longest
+// line, so a line's neighbours are in the 3x3 cells around its center.
+typedef struct {
+  double cellSize;
+  int width;
+  int height;
+  int *heads;  // first line in each cell, -1 if none
+  int *next;   // next line in the same cell
+} PlacementGrid;
+
+static void cellOf(const PlacementGrid *grid, const GeneratedLine *line,
+                   int *cx, int *cy) {
+  *cx = (int) ((line->x1 + line->x2) / 2 / grid->cellSize);
+  *cy = (int) ((line->y1 + line->y2) / 2 / grid->cellSize);
+  *cx = *cx < 0 ? 0 : (*cx >= grid->width ? grid->width - 1 : *cx);
+  *cy = *cy < 0 ? 0 : (*cy >= grid->height ? grid->height - 1 : *cy);
+}
+
+static bool overlapsPlaced(const PlacementGrid *grid,
+                           const GeneratedLine *lines,
+                           const GeneratedLine *candidate) {
+  int cx, cy;
+  cellOf(grid, candidate, &cx, &cy);
+  for (int y = cy - 1; y <= cy + 1; y++) {
+    for (int x = cx - 1; x <= cx + 1; x++) {
+      if (x < 0 || y < 0 || x >= grid->width || y >= grid->height) {
+        continue;
+      }
+      for (int i = grid->heads[y * grid->width + x]; i >= 0;
+           i = grid->next[i]) {
+        if (segmentsIntersect(&lines[i], candidate)) {
+          return true;
+        }
+      }
+    }
+  }
+  return false;
+}
+
+// Places line index, retrying until it is inside the window and, unless
+// overlaps are allowed, crosses no line placed so far.
+static bool generateLine(const SceneGenOptions *options,
+                         const double *clusters, PlacementGrid *grid,
+                         GeneratedLine *lines, unsigned int index) {
+  GeneratedLine *line = &lines[index];
+  const bool straddles = randomUniform() < options->straddleFraction;
+  line->isStatic = randomUniform() < options->staticFraction;
+  line->isGray = randomUniform() < options->grayFraction;
+
+  for (int attempt = 0; attempt < MAX_PLACEMENT_ATTEMPTS; attempt++) {
+    double x, y;
+    pickCenter(options, clusters, &x, &y);
+    if (straddles) {
+      snapToMidline(&x, &y);
+    }
+    double length = options->length
+        * randomRange(1 - options->lengthSpread, 1 + options->lengthSpread);
+    double angle = randomRange(0, M_PI);
+    double dx = length / 2 * cos(angle);
+    double dy = length / 2 * sin(angle);
+    line->x1 = quantize(x - dx);
+    line->y1 = quantize(y - dy);
+    line->x2 = quantize(x + dx);
+    line->y2 = quantize(y + dy);
+    if (fmin(line->x1, line->x2) < EDGE_MARGIN
+        || fmax(line->x1, line->x2) > WINDOW_WIDTH - EDGE_MARGIN
+        || fmin(line->y1, line->y2) < EDGE_MARGIN
+        || fmax(line->y1, line->y2) > WINDOW_HEIGHT - EDGE_MARGIN
+        || (!options->allowOverlaps && overlapsPlaced(grid, lines, line))) {
+      continue;
+    }
+
+    double speed = options->speed
+        * randomRange(1 - options->speedSpread, 1 + options->speedSpread);
+    double heading = randomRange(0, 2 * M_PI);
+    line->vx = line->isStatic ? 0 : quantize(speed * cos(heading));
+    line->vy = line->isStatic ? 0 : quantize(speed * sin(heading));
+
+    if (!options->allowOverlaps) {
+      int cx, cy;
+      cellOf(grid, line, &cx, &cy);
+      grid->next[index] = grid->heads[cy * grid->width + cx];
+      grid->heads[cy * grid->width + cx] = index;
+    }
+    return true;
+  }
+  return false;
+}
+
+static bool writeText(const char *path, const GeneratedLine *lines,
+                      unsigned int numOfLines) {
+  FILE *fout = fopen(path, "w");
+  if (fout == NULL) {
+    perror(path);
+    return false;
+  }
+  bool ok = fprintf(fout, "%u\n", numOfLines) > 0;
+  for (unsigned int i = 0; ok && i < numOfLines; i++) {
+    const GeneratedLine *line = &lines[i];
+    ok = fprintf(fout, "(%f, %f), (%f, %f), %f, %f, %d%s\n",
+                 line->x1, line->y1, line->x2, line->y2, line->vx, line->vy,
+                 line->isGray, line->isStatic ? ", 1" : "") > 0;
+  }
+  if (fclose(fout) != 0) {
+    ok = false;
+  }
+  if (!ok) {
+    perror(path);
+  }
+  return ok;
+}
+
+static bool writeBinary(const char *path, const GeneratedLine *lines,
+                        unsigned int numOfLines) {
+  FILE *fout = SceneFile_create(path, numOfLines);
+  if (fout == NULL) {
+    return false;
+  }
+  bool ok = true;
+  for (unsigned int i = 0; ok && i < numOfLines; i++) {
+    const GeneratedLine *line = &lines[i];
+    SceneRecord record;
+    memset(&record, 0, sizeof(record));
+    windowToBox(&record.p1.x, &record.p1.y, line->x1, line->y1);
+    windowToBox(&record.p2.x, &record.p2.y, line->x2, line->y2);
+    velocityWindowToBox(&record.velocity.x, &record.velocity.y,
+                        line->vx, line->vy);
+    record.color = line->isGray ? GRAY : RED;
+    record.kind = line->isStatic ? STATIC_LINE : DYNAMIC_LINE;
+    ok = SceneFile_writeRecord(fout, &record);
+  }
+  if (fclose(fout) != 0) {
+    ok = false;
+  }
+  if (!ok) {
+    perror(path);
+  }
+  return ok;
+}
+
+static void usage(const char *program) {
+  printf("Usage: %s [options] <output>\n", program);
+  printf("  -n lines    number of lines (default 100000)\n");
+  printf("  -s seed     random seed (default 1)\n");
+  printf("  -d profile  background density: uniform, gradient or center\n");
+  printf("  -c count    number of clusters (default 0)\n");
+  printf("  -f fraction fraction of lines placed in clusters (default 0.5)\n");
+  printf("  -r radius   cluster radius in pixels (default 40)\n");
+  printf("  -l length   mean line length in pixels (default 8)\n");
+  printf("  -L spread   relative spread of line lengths (default 0.5)\n");
+  printf("  -v speed    mean speed in pixels per time unit (default 0.3)\n");
+  printf("  -V spread   relative spread of speeds (default 0.5)\n");
+  printf("  -m fraction fraction of lines centered on a quadtree midline\n");
+  printf("  -S fraction fraction of static lines (default 0)\n");
+  printf("  -g fraction fraction of gray lines (default 0.5)\n");
+  printf("  -o          allow lines to start out overlapping\n");
+  printf("  -b          write the binary scene format instead of text\n");
+  exit(-1);
+}
+
+int main(int argc, char *argv[]) {
+  SceneGenOptions options = {
+    .numOfLines = 100000,
+    .seed = 1,
+    .density = UNIFORM_DENSITY,
+    .numOfClusters = 0,
+    .clusterFraction = 0.5,
+    .clusterRadius = 40,
+    .length = 8,
+    .lengthSpread = 0.5,
+    .speed = 0.3,
+    .speedSpread = 0.5,
+    .straddleFraction = 0,
+    .staticFraction = 0,
+    .grayFraction = 0.5,
+    .allowOverlaps = false,
+    .binary = false,
+  };
+
+  int optchar;
+  while ((optchar = getopt(argc, argv, "n:s:d:c:f:r:l:L:v:V:m:S:g:ob")) != -1) {
+    switch (optchar) {
+      case 'n': options.numOfLines = strtoul(optarg, NULL, 10); break;
+      case 's': options.seed = strtoull(optarg, NULL, 10); break;
+      case 'd':
+        if (strcmp(optarg, "uniform") == 0) {
+          options.density = UNIFORM_DENSITY;
+        } else if (strcmp(optarg, "gradient") == 0) {
+          options.density = GRADIENT_DENSITY;
+        } else if (strcmp(optarg, "center") == 0) {
+          options.density = CENTER_DENSITY;
+        } else {
+          usage(argv[0]);
+        }
+        break;
+      case 'c': options.numOfClusters = strtoul(optarg, NULL, 10); break;
+      case 'f': options.clusterFraction = atof(optarg); break;
+      case 'r': options.clusterRadius = atof(optarg); break;
+      case 'l': options.length = atof(optarg); break;
+      case 'L': options.lengthSpread = atof(optarg); break;
+      case 'v': options.speed = atof(optarg); break;
+      case 'V': options.speedSpread = atof(optarg); break;
+      case 'm': options.straddleFraction = atof(optarg); break;
+      case 'S': options.staticFraction = atof(optarg); break;
+      case 'g': options.grayFraction = atof(optarg); break;
+      case 'o': options.allowOverlaps = true; break;
+      case 'b': options.binary = true; break;
+      default: usage(argv[0]);
+    }
+  }
+  if (optind != argc - 1 || options.numOfLines == 0
+      || options.length <= 0 || options.lengthSpread < 0
+      || options.lengthSpread > 1 || options.speedSpread < 0
+      || options.speedSpread > 1) {
+    usage(argv[0]);
+  }
+  const char *path = argv[optind];
+
+  randomState = options.seed;
+  double *clusters = malloc(2 * (options.numOfClusters + 1) * sizeof(double));
+  for (unsigned int i = 0; i < options.numOfClusters; i++) {
+    clusters[2 * i] = WINDOW_WIDTH * randomUniform();
+    clusters[2 * i + 1] = WINDOW_HEIGHT * randomUniform();
+  }
+
+  PlacementGrid grid;
+  grid.cellSize = fmax(options.length * (1 + options.lengthSpread), 1.0);
+  grid.width = (int) ceil(WINDOW_WIDTH / grid.cellSize);
+  grid.height = (int) ceil(WINDOW_HEIGHT / grid.cellSize);
+  grid.heads = malloc((size_t) grid.width * grid.height * sizeof(int));
+  memset(grid.heads, -1, (size_t) grid.width * grid.height * sizeof(int));
+  grid.next = malloc(options.numOfLines * sizeof(int));
+
+  GeneratedLine *lines = malloc(options.numOfLines * sizeof(GeneratedLine));
+  for (unsigned int i = 0; i < options.numOfLines; i++) {
+    if (!generateLine(&options, clusters, &grid, lines, i)) {
+      fprintf(stderr, "Could only place %u of %u lines; use fewer or shorter "
+              "lines, or -o\n", i, options.numOfLines);
+      exit(1);
+    }
+  }
+
+  bool ok = options.binary
+      ? writeBinary(path, lines, options.numOfLines)
+      : writeText(path, lines, options.numOfLines);
+  if (ok) {
+    printf("Wrote %u lines to %s\n", options.numOfLines, path);
+  }
+
+  free(lines);
+  free(grid.heads);
+  free(grid.next);
+  free(clusters);
+  return ok ? 0 : 1;
+}
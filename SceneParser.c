@@ -0,0 +1,346 @@
+/*
+ * SceneParser.c -- parallel parser for line.in text scenes
+ */
+
+#include "./SceneParser.h"
+
+#include <fcntl.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cilk/cilk.h>
+
+#include "./Line.h"
+
+// Target number of bytes per parse task.
+#define PARSE_CHUNK_BYTES (1 << 20)
+
+// A newline-aligned range of the file, parsed by one task.
+struct ParseChunk {
+  const char *begin;
+  const char *end;
+  unsigned int numOfRecords;    // non-blank lines in the chunk
+  unsigned int firstRecord;     // index of the chunk's first record
+  unsigned int firstLineNumber; // file line number of begin
+  unsigned int numOfNewlines;
+};
+typedef struct ParseChunk ParseChunk;
+
+// Exact powers of ten; every one of them is representable in a double.
+static const double POWERS_OF_TEN[] = {
+  1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static inline bool isBlank(char c) {
+  return c == ' ' || c == '\t' || c == '\r';
+}
+
+static inline const char* skipBlanks(const char *cursor, const char *end) {
+  while (cursor < end && isBlank(*cursor)) {
+    cursor++;
+  }
+  return cursor;
+}
+
+// Consume the character c, after any blanks.
+static inline bool expect(const char **cursor, const char *end, char c) {
+  const char *p = skipBlanks(*cursor, end);
+  if (p == end || *p != c) {
+    return false;
+  }
+  *cursor = p + 1;
+  return true;
+}
+
+// Parse a decimal number such as "-12.5e3".  When its significant digits
+// fit in 53 bits (15 digits, or 16 below 2^53) and its decimal exponent is
+// within +-22, the mantissa and the power of ten are both exact, so one
+// multiplication or division rounds it correctly; that covers everything
+// line.in writers emit.  Other numbers are handed to strtod, so every
+// number reads as scanf would read it.
+static bool parseDouble(const char **cursor, const char *end, double *out) {
+  const char *p = skipBlanks(*cursor, end);
+  const char *start = p;
+  bool negative = false;
+  if (p < end && (*p == '-' || *p == '+')) {
+    negative = *p == '-';
+    p++;
+  }
+
+  uint64_t mantissa = 0;
+  int digits = 0;
+  int exponent = 0;
+  bool sawDigit = false;
+  for (; p < end && *p >= '0' && *p <= '9'; p++) {
+    sawDigit = true;
+    if (digits < 19) {
+      mantissa = mantissa * 10 + (*p - '0');
+      digits += mantissa != 0;
+    } else {
+      exponent++;
+    }
+  }
+  if (p < end && *p == '.') {
+    for (p++; p < end && *p >= '0' && *p <= '9'; p++) {
+      sawDigit = true;
+      if (digits < 19) {
+        mantissa = mantissa * 10 + (*p - '0');
+        digits += mantissa != 0;
+        exponent--;
+      }
+    }
+  }
+  if (!sawDigit) {
+    return false;
+  }
+  if (p < end && (*p == 'e' || *p == 'E')) {
+    p++;
+    bool negativeExponent = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+      negativeExponent = *p == '-';
+      p++;
+    }
+    if (p == end || *p < '0' || *p > '9') {
+      return false;
+    }
+    int explicitExponent = 0;
+    for (; p < end && *p >= '0' && *p <= '9'; p++) {
+      if (explicitExponent < 100000) {
+        explicitExponent = explicitExponent * 10 + (*p - '0');
+      }
+    }
+    exponent += negativeExponent ? -explicitExponent : explicitExponent;
+  }
+
+  double value;
+  if (mantissa == 0) {
+    value = 0;
+  } else if (mantissa < (UINT64_C(1) << 53)
+             && exponent >= -22 && exponent <= 22) {
+    value = (double) mantissa;
+    value = exponent < 0 ? value / POWERS_OF_TEN[-exponent]
+        : value * POWERS_OF_TEN[exponent];
+  } else {
+    // the text isn't terminated, so strtod gets a copy of the number
+    const size_t length = p - start;
+    char buffer[64];
+    char *copy = length < sizeof(buffer) ? buffer : malloc(length + 1);
+    memcpy(copy, start, length);
+    copy[length] = '\0';
+    *out = strtod(copy, NULL);
+    if (copy != buffer) {
+      free(copy);
+    }
+    *cursor = p;
+    return true;
+  }
+  *out = negative ? -value : value;
+  *cursor = p;
+  return true;
+}
+
+static bool parseInt(const char **cursor, const char *end, int *out) {
+  const char *p = skipBlanks(*cursor, end);
+  bool negative = false;
+  if (p < end && (*p == '-' || *p == '+')) {
+    negative = *p == '-';
+    p++;
+  }
+  if (p == end || *p < '0' || *p > '9') {
+    return false;
+  }
+  int value = 0;
+  for (; p < end && *p >= '0' && *p <= '9'; p++) {
+    if (value > (INT_MAX - (*p - '0')) / 10) {
+      return false;
+    }
+    value = value * 10 + (*p - '0');
+  }
+  *out = negative ? -value : value;
+  *cursor = p;
+  return true;
+}
+
+// Parse "(x1, y1), (x2, y2), vx, vy, isGray[, isStatic]" into line.
+static bool parseRecord(const char *cursor, const char *end, Line *line,
+                        unsigned int id, double timeStep) {
+  window_dimension px1, py1, px2, py2, vx, vy;
+  int isGray;
+  int isStatic = 0;
+  if (!(expect(&cursor, end, '(') && parseDouble(&cursor, end, &px1)
+        && expect(&cursor, end, ',') && parseDouble(&cursor, end, &py1)
+        && expect(&cursor, end, ')') && expect(&cursor, end, ',')
+        && expect(&cursor, end, '(') && parseDouble(&cursor, end, &px2)
+        && expect(&cursor, end, ',') && parseDouble(&cursor, end, &py2)
+        && expect(&cursor, end, ')') && expect(&cursor, end, ',')
+        && parseDouble(&cursor, end, &vx) && expect(&cursor, end, ',')
+        && parseDouble(&cursor, end, &vy) && expect(&cursor, end, ',')
+        && parseInt(&cursor, end, &isGray))) {
+    return false;
+  }
+  if (expect(&cursor, end, ',') && !parseInt(&cursor, end, &isStatic)) {
+    return false;
+  }
+  if (skipBlanks(cursor, end) != end || (isGray != RED && isGray != GRAY)
+      || (isStatic != 0 && isStatic != 1)) {
+    return false;
+  }
+
+  Vec p1;
+  Vec p2;
+  Vec velocity;
+  windowToBox(&p1.x, &p1.y, px1, py1);
+  windowToBox(&p2.x, &p2.y, px2, py2);
+  velocityWindowToBox(&velocity.x, &velocity.y, vx, vy);
+  initLine(line, p1, p2, velocity, (Color) isGray,
+           isStatic ? STATIC_LINE : DYNAMIC_LINE, id, timeStep);
+  return true;
+}
+
+// End of the text line starting at cursor (the newline, or end).
+static inline const char* lineEnd(const char *cursor, const char *end) {
+  const char *newline = memchr(cursor, '\n', end - cursor);
+  return newline == NULL ? end : newline;
+}
+
+static inline bool isBlankLine(const char *cursor, const char *end) {
+  return skipBlanks(cursor, end) == end;
+}
+
+static void countRecords(ParseChunk *chunk) {
+  chunk->numOfRecords = 0;
+  chunk->numOfNewlines = 0;
+  const char *cursor = chunk->begin;
+  while (cursor < chunk->end) {
+    const char *eol = lineEnd(cursor, chunk->end);
+    chunk->numOfRecords += !isBlankLine(cursor, eol);
+    chunk->numOfNewlines += eol < chunk->end;
+    cursor = eol + 1;
+  }
+}
+
+// Parse the chunk's records into lines[firstRecord...].  Returns the
+// number of malformed records, each reported with its line number.
+static unsigned int parseChunk(const ParseChunk *chunk, const char *path,
+                               Line *lines, double timeStep) {
+  unsigned int malformed = 0;
+  unsigned int record = chunk->firstRecord;
+  unsigned int lineNumber = chunk->firstLineNumber;
+  const char *cursor = chunk->begin;
+  while (cursor < chunk->end) {
+    const char *eol = lineEnd(cursor, chunk->end);
+    if (!isBlankLine(cursor, eol)) {
+      if (!parseRecord(cursor, eol, &lines[record], record, timeStep)) {
+        fprintf(stderr, "%s:%u: malformed line record\n", path, lineNumber);
+        malformed++;
+      }
+      record++;
+    }
+    lineNumber++;
+    cursor = eol + 1;
+  }
+  return malformed;
+}
+
+CollisionWorld* SceneParser_load(const char *path) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    perror(path);
+    return NULL;
+  }
+  struct stat status;
+  if (fstat(fd, &status) != 0) {
+    perror(path);
+    close(fd);
+    return NULL;
+  }
+  size_t size = status.st_size;
+  if (size == 0) {
+    fprintf(stderr, "%s: empty scene\n", path);
+    close(fd);
+    return NULL;
+  }
+  const char *text = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (text == MAP_FAILED) {
+    perror(path);
+    return NULL;
+  }
+  const char *end = text + size;
+
+  // The header holds the line count; it is only checked, never trusted.
+  const char *body = lineEnd(text, end);
+  int declaredLines = -1;
+  const char *cursor = text;
+  if (!parseInt(&cursor, body, &declaredLines)
+      || !isBlankLine(cursor, body)) {
+    fprintf(stderr, "%s:1: malformed line count\n", path);
+  }
+  body = body < end ? body + 1 : end;
+
+  // Split the body into newline-aligned chunks.
+  unsigned int maxChunks = (end - body) / PARSE_CHUNK_BYTES + 1;
+  ParseChunk *chunks = malloc(maxChunks * sizeof(ParseChunk));
+  unsigned int numOfChunks = 0;
+  for (const char *begin = body; begin < end; numOfChunks++) {
+    const char *chunkEnd = begin + PARSE_CHUNK_BYTES;
+    chunkEnd = chunkEnd >= end ? end : lineEnd(chunkEnd, end);
+    chunkEnd = chunkEnd < end ? chunkEnd + 1 : end;
+    chunks[numOfChunks].begin = begin;
+    chunks[numOfChunks].end = chunkEnd;
+    begin = chunkEnd;
+  }
+
+  cilk_for (unsigned int c = 0; c < numOfChunks; c++) {
+    countRecords(&chunks[c]);
+  }
+
+  unsigned int numOfRecords = 0;
+  unsigned int lineNumber = 2;
+  for (unsigned int c = 0; c < numOfChunks; c++) {
+    chunks[c].firstRecord = numOfRecords;
+    chunks[c].firstLineNumber = lineNumber;
+    numOfRecords += chunks[c].numOfRecords;
+    lineNumber += chunks[c].numOfNewlines;
+  }
+  if (numOfRecords == 0) {
+    fprintf(stderr, "%s: scene holds no lines\n", path);
+    free(chunks);
+    munmap((void *) text, size);
+    return NULL;
+  }
+
+  CollisionWorld *collisionWorld = CollisionWorld_new(numOfRecords);
+  Line *lines = CollisionWorld_reserveLines(collisionWorld, numOfRecords);
+  unsigned int *malformed = malloc(numOfChunks * sizeof(unsigned int));
+  cilk_for (unsigned int c = 0; c < numOfChunks; c++) {
+    malformed[c] = parseChunk(&chunks[c], path, lines,
+                              collisionWorld->timeStep);
+  }
+  unsigned int numOfMalformed = 0;
+  for (unsigned int c = 0; c < numOfChunks; c++) {
+    numOfMalformed += malformed[c];
+  }
+  free(malformed);
+  free(chunks);
+  munmap((void *) text, size);
+  if (numOfMalformed > 0) {
+    fprintf(stderr, "%s: %u malformed records\n", path, numOfMalformed);
+    CollisionWorld_delete(collisionWorld);
+    return NULL;
+  }
+
+  if (declaredLines >= 0 && (unsigned int) declaredLines != numOfRecords) {
+    fprintf(stderr, "%s: header declares %d lines but %u were read\n", path,
+            declaredLines, numOfRecords);
+  }
+  CollisionWorld_commitLines(collisionWorld, lines, numOfRecords);
+  return collisionWorld;
+}
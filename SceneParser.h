@@ -0,0 +1,20 @@
+/*
+ * SceneParser.h -- parallel parser for line.in text scenes
+ *
+ * The file is mapped and split at newline boundaries into chunks that are
+ * parsed in parallel, straight into preallocated line storage.  Line ids
+ * follow file order.  Numbers are parsed without the C locale, so a
+ * process-wide setlocale cannot change the decimal separator.
+ */
+
+#ifndef SCENEPARSER_H_
+#define SCENEPARSER_H_
+
+#include "./CollisionWorld.h"
+
+// Parse the text scene at path into a new CollisionWorld.  Returns NULL,
+// after printing why, if the file can't be read, holds no lines or holds
+// malformed records, which are reported with their line numbers.
+CollisionWorld* SceneParser_load(const char *path);
+
+#endif  // SCENEPARSER_H_
@@ -20,16 +20,26 @@
  * SOFTWARE.
  **/
 
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
+#include "./Checkpoint.h"
+#include "./Differential.h"
 #include "./fasttime.h"
+#include "./HeatMap.h"
 #include "./Line.h"
 #include "./LineDemo.h"
+#include "./MemoryStats.h"
 #include "./Quadtree.h"
+#include "./QuadtreeStats.h"
+#include "./Rasterizer.h"
+#include "./Tracer.h"
+#include "./Trajectory.h"
 #include <cilk/cilk.h>
-#include <cilk/reducer.h>
+#include <cilk/cilk_api.h>
 
 // The PROFILE_BUILD preprocessor define is used to indicate we are building for
 // profiling, so don't include any graphics or Cilk functions.
@@ -38,30 +48,155 @@
 #endif
 static char* DEFAULT_INPUT_FILE_PATH = "line.in";
 static char* input_file_path;
+static bool reportActiveLines = false;
+static bool countEvents = false;
+static bool differential = false;
+static bool reportMemory = false;
+static bool trackMemoryPeak = false;
+static unsigned int divergentFrames = 0;
+static char* checkpoint_file_path = NULL;
+static unsigned int checkpointInterval = 1000;
+static char* resume_file_path = NULL;
+static char* trajectory_file_path = NULL;
+static char* phase_log_file_path = NULL;
+static char* trace_file_path = NULL;
+static char* heat_map_prefix = NULL;
+static char* frame_prefix = NULL;
+static unsigned int quadtreeStatsInterval = 0;
 
-//typedef CILK_C_DECLARE_REDUCER(IntersectionEventList) IntersectionEventListReducer;
+// Pair test totals, and the next frame, at the last quadtree report.
+static uint64_t lastRejects, lastTests, lastSkips, lastEvents;
+static unsigned int firstReportFrame;
+
+// Prints the pair tests of the frames since the last report, and the shape
+// of the quadtree the next frame will traverse.
+static void printQuadtreeReport(CollisionWorld *collisionWorld,
+                                unsigned int frame) {
+  if (frame == firstReportFrame) {
+    printf("Frame %u: ", frame);
+  } else {
+    printf("Frames %u-%u: ", firstReportFrame, frame);
+  }
+  printf("%" PRIu64 " box prefilter rejects, %" PRIu64 " intersect() calls, "
+         "%" PRIu64 " certificate skips, %" PRIu64 " events\n",
+         collisionWorld->numBoxRejects - lastRejects,
+         collisionWorld->numNarrowPhaseTests - lastTests,
+         collisionWorld->numNarrowPhaseSkips - lastSkips,
+         collisionWorld->numEvents - lastEvents);
+  lastRejects = collisionWorld->numBoxRejects;
+  lastTests = collisionWorld->numNarrowPhaseTests;
+  lastSkips = collisionWorld->numNarrowPhaseSkips;
+  lastEvents = collisionWorld->numEvents;
+  firstReportFrame = frame + 1;
+
+  QuadtreeStats stats;
+  getQuadtreeStats(collisionWorld->quadtree, &stats);
+  printQuadtreeStats(&stats);
+}
 
 // For non-graphic version
 void lineMain(LineDemo *lineDemo) {
   // Loop for updating line movement simulation
   // while (LineDemo_update(lineDemo)) {}
 
-  globalQuadtree = instantiateRoot(lineDemo->collisionWorld);
+  // a resumed run already has its quadtrees
+  if (resume_file_path == NULL) {
+    CollisionWorld_buildQuadtrees(lineDemo->collisionWorld);
+  }
 
-  IntersectionEventListReducer X = CILK_C_INIT_REDUCER(/*type*/ IntersectionEventList,
-    	IntersectionEventList_reduce, IntersectionEventList_identity, IntersectionEventList_destroy,
-    	/* initial value */ IntersectionEventList_make());
-  CILK_C_REGISTER_REDUCER(X);
+  // a resumed run reports only its own frames
+  lastRejects = lineDemo->collisionWorld->numBoxRejects;
+  lastTests = lineDemo->collisionWorld->numNarrowPhaseTests;
+  lastSkips = lineDemo->collisionWorld->numNarrowPhaseSkips;
+  lastEvents = lineDemo->collisionWorld->numEvents;
+  firstReportFrame = lineDemo->count;
 
+  Trajectory *trajectory = NULL;
+  if (trajectory_file_path != NULL) {
+    trajectory = Trajectory_open(trajectory_file_path,
+                                 lineDemo->collisionWorld);
+  }
+  CheckpointWriter *checkpointWriter = NULL;
+  if (checkpoint_file_path != NULL) {
+    checkpointWriter = Checkpoint_newWriter(checkpoint_file_path);
+  }
+
+  Rasterizer *rasterizer = NULL;
+  char *frame_path = NULL;
+  unsigned int framesDrawn = 0;
+  double drawSeconds = 0;
+  double writeSeconds = 0;
+  if (frame_prefix != NULL) {
+    rasterizer = Rasterizer_new(WINDOW_WIDTH, WINDOW_HEIGHT);
+    frame_path = malloc(strlen(frame_prefix) + sizeof("000000.ppm"));
+  }
+
+#ifdef MEMORY_STATS
+  MemoryStats_startFrames(lineDemo->collisionWorld);
+#endif
   while (lineDemo->count <= lineDemo->numFrames) {
-	  CollisionWorld_updateLines(lineDemo->collisionWorld, &X);
+	  if (differential) {
+	    Differential_updateLines(lineDemo->collisionWorld, lineDemo->count);
+	  } else {
+	    CollisionWorld_updateLines(lineDemo->collisionWorld);
+	  }
+	  if (reportActiveLines) {
+	    printf("Frame %u: %u active lines\n", lineDemo->count,
+	           CollisionWorld_getNumActiveLines(lineDemo->collisionWorld));
+	  }
+	  if (quadtreeStatsInterval != 0
+	      && lineDemo->count % quadtreeStatsInterval == 0) {
+	    printQuadtreeReport(lineDemo->collisionWorld, lineDemo->count);
+	  }
+	  if (trajectory != NULL) {
+	    Trajectory_writeFrame(trajectory, lineDemo->count);
+	  }
+	  if (rasterizer != NULL) {
+	    const fasttime_t draw_start_time = gettime();
+	    Rasterizer_draw(rasterizer, lineDemo->collisionWorld);
+	    const fasttime_t draw_end_time = gettime();
+	    sprintf(frame_path, "%s%06u.ppm", frame_prefix, lineDemo->count);
+	    if (!Rasterizer_writePPM(rasterizer, frame_path)) {
+	      exit(-1);
+	    }
+	    drawSeconds += tdiff(draw_start_time, draw_end_time);
+	    writeSeconds += tdiff(draw_end_time, gettime());
+	    framesDrawn++;
+	  }
 	  lineDemo->count++;
-	  X.value = IntersectionEventList_make();
-	  //printf("%p", X.value.tail);
+	  if (checkpointWriter != NULL
+	      && lineDemo->count % checkpointInterval == 0) {
+	    Checkpoint_save(checkpointWriter, lineDemo);
+	  }
+  }
+  if (differential) {
+    divergentFrames = Differential_finish(lineDemo->collisionWorld);
+  }
+  if (trajectory != NULL && !Trajectory_close(trajectory)) {
+    printf("Warning: writing the trajectory failed\n");
+  }
+  if (checkpointWriter != NULL && !Checkpoint_finish(checkpointWriter)) {
+    printf("Warning: writing a checkpoint failed\n");
+  }
+  if (rasterizer != NULL) {
+    printf("Rendering: %u frames at %dx%d, %fs drawing (%.1f frames/s), "
+           "%fs writing\n", framesDrawn, WINDOW_WIDTH, WINDOW_HEIGHT,
+           drawSeconds, drawSeconds > 0 ? framesDrawn / drawSeconds : 0.0,
+           writeSeconds);
+    Rasterizer_delete(rasterizer);
+    free(frame_path);
+  }
+#ifdef MEMORY_STATS
+  if (reportMemory) {
+    MemoryStats_print(lineDemo->collisionWorld);
+  }
+#endif
+#ifdef HEAT_MAP
+  if (heat_map_prefix != NULL
+      && !HeatMap_write(lineDemo->collisionWorld->quadtree, heat_map_prefix)) {
+    printf("Warning: writing the heat map failed\n");
   }
-  
-  freeNode(globalQuadtree);
-  CILK_C_UNREGISTER_REDUCER(X);
+#endif
 }
 
 int main(int argc, char *argv[]) {
@@ -73,8 +208,11 @@ int main(int argc, char *argv[]) {
   unsigned int numFrames = 1;
   extern int optind;
 
+  // The demo runs one simulation on one worker.
+  __cilkrts_set_param("nworkers", "1");
+
   // Process command line options.
-  while ((optchar = getopt(argc, argv, "gi")) != -1) {
+  while ((optchar = getopt(argc, argv, "giaeduUc:j:m:n:o:p:q:r:t:")) != -1) {
     switch (optchar) {
       case 'g':
 #ifndef PROFILE_BUILD
@@ -87,6 +225,56 @@ int main(int argc, char *argv[]) {
         graphicDemoFlag = true;
 #endif
         break;
+      case 'a':
+        reportActiveLines = true;
+        break;
+      case 'e':
+        countEvents = true;
+        break;
+      case 'd':
+        differential = true;
+        break;
+      case 'U':
+        trackMemoryPeak = true;
+        // fall through
+      case 'u':
+        reportMemory = true;
+        break;
+      case 'c':
+        checkpoint_file_path = optarg;
+        break;
+      case 'j':
+        trace_file_path = optarg;
+        break;
+      case 'm':
+        heat_map_prefix = optarg;
+        break;
+      case 'n':
+        checkpointInterval = atoi(optarg);
+        if (checkpointInterval == 0) {
+          printf("Checkpoint interval must be positive\n");
+          exit(-1);
+        }
+        break;
+      case 'o':
+        frame_prefix = optarg;
+        break;
+      case 'p':
+        phase_log_file_path = optarg;
+        break;
+      case 'q':
+        quadtreeStatsInterval = atoi(optarg);
+        if (quadtreeStatsInterval == 0) {
+          printf("Quadtree statistics interval must be positive\n");
+          exit(-1);
+        }
+        break;
+      case 'r':
+        resume_file_path = optarg;
+        break;
+      case 't':
+        trajectory_file_path = optarg;
+        break;
       default:
         printf("Ignoring unrecognized option: %c\n", optchar);
         continue;
@@ -102,9 +290,32 @@ int main(int argc, char *argv[]) {
 
     // Check to make sure number of arguments is correct.
     if (remaining_args < 1) {
-      printf("Usage: %s [-g] [-i] <numFrames> <optional input_file>\n", argv[0]);
+      printf("Usage: %s [-g] [-i] [-a] [-e] [-d] [-u] [-U] [-c checkpoint_file] "
+             "[-j trace_file] [-m heat_map_prefix] [-n interval] [-o frame_prefix] [-p phase_log_file] [-q interval] [-r checkpoint_file] [-t trajectory_file] <numFrames> <optional input_file>\n", argv[0]);
       printf("  -g : show graphics\n");
       printf("  -i : show first image only (ignore numFrames)\n");
+      printf("  -a : print the number of active (awake) lines each frame\n");
+      printf("  -e : count hardware events per phase and thread "
+             "(needs make PHASE_TIMING=1)\n");
+      printf("  -d : check each frame's events against brute force, "
+             "and report both times\n");
+      printf("  -u : report memory use by subsystem and allocations per frame "
+             "(needs make MEMORY_STATS=1)\n");
+      printf("  -U : as -u, and track the peak memory use\n");
+      printf("  -c : write a checkpoint to checkpoint_file every interval frames\n");
+      printf("  -j : write a Chrome trace of the parallel tasks to trace_file "
+             "(needs make TRACING=1)\n");
+      printf("  -m : write where traverseQuadtree spent its work to "
+             "heat_map_prefix.ppm and .tsv (needs make HEAT_MAP=1)\n");
+      printf("  -n : frames between checkpoints (default 1000)\n");
+      printf("  -o : draw every frame without X11 to frame_prefixNNNNNN.ppm "
+             "and report the drawing rate\n");
+      printf("  -p : log per-phase frame times to phase_log_file as CSV "
+             "(needs make PHASE_TIMING=1)\n");
+      printf("  -q : print quadtree shape and pair test counts every interval frames\n");
+      printf("  -r : resume from checkpoint_file instead of loading input_file\n");
+      printf("  -t : write compressed line positions to trajectory_file each frame\n");
+      printf("       (with -g, each frame drawn)\n");
       exit(-1);
     }
 
@@ -115,22 +326,106 @@ int main(int argc, char *argv[]) {
       input_file_path = DEFAULT_INPUT_FILE_PATH;
     }
 
-    printf("Input file path is: %s\n", input_file_path);
+    if (resume_file_path == NULL) {
+      printf("Input file path is: %s\n", input_file_path);
+    }
     printf("Number of frames = %u\n", numFrames);
   }
 
+  if (reportMemory) {
+#ifdef MEMORY_STATS
+    if (trackMemoryPeak) {
+      MemoryStats_trackPeak();
+    }
+#else
+    printf("Memory statistics are not built in; rebuild with make MEMORY_STATS=1\n");
+    exit(-1);
+#endif
+  }
+
   // Create and initialize the Line simulation environment.
   LineDemo *lineDemo = LineDemo_new();
   LineDemo_setInputFile(input_file_path);
-  LineDemo_initLine(lineDemo);
+  const fasttime_t load_start_time = gettime();
+  if (resume_file_path != NULL) {
+#ifndef PROFILE_BUILD
+    if (graphicDemoFlag) {
+      printf("Resuming from a checkpoint is not supported with graphics\n");
+      exit(-1);
+    }
+#endif
+    if (!Checkpoint_restore(resume_file_path, lineDemo)) {
+      exit(-1);
+    }
+    printf("Resumed from %s at frame %u\n", resume_file_path, lineDemo->count);
+  } else {
+    LineDemo_initLine(lineDemo);
+  }
+  const fasttime_t load_end_time = gettime();
   LineDemo_setNumFrames(lineDemo, numFrames);
+  if (phase_log_file_path != NULL || countEvents) {
+#ifdef PHASE_TIMING
+    PhaseTimers *phaseTimers = &lineDemo->collisionWorld->phaseTimers;
+    if (phase_log_file_path != NULL
+        && !PhaseTimers_openLog(phaseTimers, phase_log_file_path)) {
+      exit(-1);
+    }
+    // without counters the phase times are still recorded
+    if (countEvents) {
+      PhaseTimers_enableCounters(phaseTimers);
+    }
+#else
+    printf("Phase timing is not built in; rebuild with make PHASE_TIMING=1\n");
+    exit(-1);
+#endif
+  }
+  printf("Scene load time: %fs\n", tdiff(load_start_time, load_end_time));
+  if (trace_file_path != NULL) {
+#ifdef TRACING
+    if (!Tracer_start(trace_file_path)) {
+      exit(-1);
+    }
+#else
+    printf("Tracing is not built in; rebuild with make TRACING=1\n");
+    exit(-1);
+#endif
+  }
+#ifndef PROFILE_BUILD
+  if (frame_prefix != NULL && graphicDemoFlag) {
+    printf("Writing frames is not supported with graphics\n");
+    exit(-1);
+  }
+#endif
+  if (heat_map_prefix != NULL) {
+#ifdef HEAT_MAP
+#ifndef PROFILE_BUILD
+    if (graphicDemoFlag) {
+      printf("The heat map is not supported with graphics\n");
+      exit(-1);
+    }
+#endif
+    heatMapping = true;
+#else
+    printf("The heat map is not built in; rebuild with make HEAT_MAP=1\n");
+    exit(-1);
+#endif
+  }
 
   const fasttime_t start_time = gettime();
 
 #ifndef PROFILE_BUILD
   // Run demo.
   if (graphicDemoFlag) {
-    graphicMain(argc, argv, lineDemo, imageOnlyFlag);
+    // the renderer records the frames it draws
+    Trajectory *trajectory = NULL;
+    if (trajectory_file_path != NULL) {
+      trajectory = Trajectory_open(trajectory_file_path,
+                                   lineDemo->collisionWorld);
+    }
+    graphicMain(argc, argv, lineDemo, imageOnlyFlag, trajectory);
+    if (trajectory != NULL && !Trajectory_close(trajectory)) {
+      printf("Warning: writing the trajectory failed\n");
+    }
   } else {
     lineMain(lineDemo);
   }
@@ -139,6 +434,11 @@ int main(int argc, char *argv[]) {
 #endif
 
   const fasttime_t end_time = gettime();
+#ifdef TRACING
+  if (!Tracer_finish()) {
+    printf("Warning: writing the trace failed\n");
+  }
+#endif
 
   // Output results.
   printf("---- RESULTS ----\n");
@@ -148,10 +448,23 @@ int main(int argc, char *argv[]) {
          LineDemo_getNumLineWallCollisions(lineDemo));
   printf("%u Line-Line Collisions\n",
          LineDemo_getNumLineLineCollisions(lineDemo));
+  uint64_t tests = lineDemo->collisionWorld->numNarrowPhaseTests;
+  uint64_t skips = lineDemo->collisionWorld->numNarrowPhaseSkips;
+  printf("%" PRIu64 " intersect() calls, %" PRIu64
+         " avoided by pair certificates (%.1f%%)\n",
+         tests, skips, tests + skips ? 100.0 * skips / (tests + skips) : 0.0);
+  printf("%" PRIu64 " pairs rejected by the box prefilter, %" PRIu64
+         " intersection events\n",
+         lineDemo->collisionWorld->numBoxRejects,
+         lineDemo->collisionWorld->numEvents);
   printf("---- END RESULTS ----\n");
+#ifdef PHASE_TIMING
+  PhaseTimers_print(&lineDemo->collisionWorld->phaseTimers);
+#endif
 
   // delete objects
   LineDemo_delete(lineDemo);
 
-  return 0;
+  // a differential run fails if the quadtree missed or invented events
+  return divergentFrames != 0;
 }
@@ -0,0 +1,212 @@
+/*
+ * Simulation.c -- the C API of libquadtree, for embedding the simulation
+ */
+
+#include "./Simulation.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+
+#include "./CollisionWorld.h"
+#include "./SceneFile.h"
+#include "./SceneParser.h"
+#include "./SpatialQuery.h"
+
+_Static_assert(SIMULATION_DYNAMIC_LINE == DYNAMIC_LINE
+               && SIMULATION_STATIC_LINE == STATIC_LINE
+               && SIMULATION_RETIRED_LINE == RETIRED_LINE,
+               "Simulation.h's line kinds must be the LineKind values");
+
+struct Simulation {
+  CollisionWorld *collisionWorld;
+  unsigned int frames;
+};
+
+int Simulation_apiVersion() {
+  return SIMULATION_API_VERSION;
+}
+
+Simulation* Simulation_load(const char *path,
+                            const SimulationParams *params) {
+  CollisionWorld *collisionWorld = SceneFile_isBinary(path)
+      ? SceneFile_load(path) : SceneParser_load(path);
+  if (collisionWorld == NULL) {
+    return NULL;
+  }
+  if (params != NULL && params->timeStep > 0) {
+    CollisionWorld_setTimeStep(collisionWorld, params->timeStep);
+  }
+  if (params != NULL && params->maxLinesPerNode > 0) {
+    collisionWorld->maxLinesPerNode = params->maxLinesPerNode;
+  }
+  CollisionWorld_buildQuadtrees(collisionWorld);
+
+  Simulation *simulation = malloc(sizeof(Simulation));
+  simulation->collisionWorld = collisionWorld;
+  simulation->frames = 0;
+  return simulation;
+}
+
+void Simulation_delete(Simulation *simulation) {
+  if (simulation == NULL) {
+    return;
+  }
+  CollisionWorld_delete(simulation->collisionWorld);
+  free(simulation);
+}
+
+void Simulation_step(Simulation *simulation, unsigned int numFrames) {
+  for (unsigned int frame = 0; frame < numFrames; frame++) {
+    CollisionWorld_updateLines(simulation->collisionWorld);
+  }
+  simulation->frames += numFrames;
+}
+
+void Simulation_lineLayout(SimulationLineLayout *layout) {
+  layout->stride = sizeof(Line);
+  layout->p1 = offsetof(Line, p1);
+  layout->p2 = offsetof(Line, p2);
+  layout->velocity = offsetof(Line, velocity);
+  layout->id = offsetof(Line, id);
+  layout->kind = offsetof(Line, kind);
+  layout->xMin = BOX_XMIN;
+  layout->xMax = BOX_XMAX;
+  layout->yMin = BOX_YMIN;
+  layout->yMax = BOX_YMAX;
+}
+
+unsigned int Simulation_numChunks(const Simulation *simulation) {
+  return simulation->collisionWorld->numOfChunks;
+}
+
+const void* Simulation_chunk(const Simulation *simulation, unsigned int chunk,
+                             unsigned int *count) {
+  if (chunk >= simulation->collisionWorld->numOfChunks) {
+    *count = 0;
+    return NULL;
+  }
+  const LineChunk *lineChunk = &simulation->collisionWorld->chunks[chunk];
+  *count = lineChunk->used;
+  return lineChunk->lines;
+}
+
+static bool inBox(const double p[2]) {
+  return p[0] >= BOX_XMIN && p[0] < BOX_XMAX
+      && p[1] >= BOX_YMIN && p[1] < BOX_YMAX;
+}
+
+// The chunk and slot of line's record.  There are only a few chunks.
+static void findSlot(const CollisionWorld *collisionWorld, const Line *line,
+                     unsigned int *chunk, unsigned int *slot) {
+  unsigned int c = 0;
+  while (line < collisionWorld->chunks[c].lines
+         || line >= collisionWorld->chunks[c].lines
+                    + collisionWorld->chunks[c].used) {
+    c++;
+  }
+  *chunk = c;
+  *slot = line - collisionWorld->chunks[c].lines;
+}
+
+int Simulation_insertLine(Simulation *simulation, const double p1[2],
+                          const double p2[2], const double velocity[2],
+                          bool gray, unsigned int *chunk,
+                          unsigned int *slot) {
+  if (!inBox(p1) || !inBox(p2)) {
+    return -1;
+  }
+  CollisionWorld *collisionWorld = simulation->collisionWorld;
+  Line line;
+  initLine(&line, Vec_make(p1[0], p1[1]), Vec_make(p2[0], p2[1]),
+           Vec_make(velocity[0], velocity[1]), gray ? GRAY : RED,
+           DYNAMIC_LINE, 0, collisionWorld->timeStep);
+  const Line *inserted = CollisionWorld_insertLine(collisionWorld, &line);
+  if (inserted == NULL) {
+    return -1;
+  }
+  findSlot(collisionWorld, inserted, chunk, slot);
+  return inserted->id;
+}
+
+bool Simulation_removeLine(Simulation *simulation, unsigned int chunk,
+                           unsigned int slot) {
+  CollisionWorld *collisionWorld = simulation->collisionWorld;
+  if (chunk >= collisionWorld->numOfChunks
+      || slot >= collisionWorld->chunks[chunk].used) {
+    return false;
+  }
+  return CollisionWorld_removeLine(collisionWorld,
+                                   &collisionWorld->chunks[chunk].lines[slot]);
+}
+
+void Simulation_getStats(const Simulation *simulation,
+                         SimulationStats *stats) {
+  const CollisionWorld *collisionWorld = simulation->collisionWorld;
+  stats->frames = simulation->frames;
+  stats->numLines = collisionWorld->numOfLines;
+  stats->numActiveLines = collisionWorld->numActiveLines;
+  stats->lineWallCollisions = collisionWorld->numLineWallCollisions;
+  stats->lineLineCollisions = collisionWorld->numLineLineCollisions;
+  stats->narrowPhaseTests = collisionWorld->numNarrowPhaseTests;
+  stats->narrowPhaseSkips = collisionWorld->numNarrowPhaseSkips;
+  stats->boxRejects = collisionWorld->numBoxRejects;
+  stats->events = collisionWorld->numEvents;
+}
+
+// Answer one query, writing at most maxMatches of its matches.
+static unsigned int query(const Simulation *simulation,
+                          const SpatialQuery *spatialQuery,
+                          SimulationMatch *matches, unsigned int maxMatches) {
+  CollisionWorld *collisionWorld = simulation->collisionWorld;
+  SpatialQueryResults results;
+  SpatialQuery_batch(collisionWorld, spatialQuery, 1, &results);
+  const unsigned int numMatches = results.first[1];
+  for (unsigned int i = 0; i < numMatches && i < maxMatches; i++) {
+    const Line *line = results.matches[i].line;
+    matches[i].id = line->id;
+    findSlot(collisionWorld, line, &matches[i].chunk, &matches[i].slot);
+    matches[i].distance = results.matches[i].distance;
+  }
+  SpatialQueryResults_free(&results);
+  return numMatches;
+}
+
+unsigned int Simulation_queryRange(const Simulation *simulation,
+                                   const double a[2], const double b[2],
+                                   SimulationMatch *matches,
+                                   unsigned int maxMatches) {
+  const SpatialQuery spatialQuery = {
+    QUERY_RANGE, Vec_make(a[0], a[1]), Vec_make(b[0], b[1]), 0, 0
+  };
+  return query(simulation, &spatialQuery, matches, maxMatches);
+}
+
+unsigned int Simulation_querySegment(const Simulation *simulation,
+                                     const double a[2], const double b[2],
+                                     SimulationMatch *matches,
+                                     unsigned int maxMatches) {
+  const SpatialQuery spatialQuery = {
+    QUERY_SEGMENT, Vec_make(a[0], a[1]), Vec_make(b[0], b[1]), 0, 0
+  };
+  return query(simulation, &spatialQuery, matches, maxMatches);
+}
+
+unsigned int Simulation_queryRadius(const Simulation *simulation,
+                                    const double centre[2], double radius,
+                                    SimulationMatch *matches,
+                                    unsigned int maxMatches) {
+  const SpatialQuery spatialQuery = {
+    QUERY_RADIUS, Vec_make(centre[0], centre[1]), Vec_make(0, 0), radius, 0
+  };
+  return query(simulation, &spatialQuery, matches, maxMatches);
+}
+
+unsigned int Simulation_queryNearest(const Simulation *simulation,
+                                     const double point[2], unsigned int k,
+                                     SimulationMatch *matches,
+                                     unsigned int maxMatches) {
+  const SpatialQuery spatialQuery = {
+    QUERY_NEAREST, Vec_make(point[0], point[1]), Vec_make(0, 0), 0, k
+  };
+  return query(simulation, &spatialQuery, matches, maxMatches);
+}
@@ -0,0 +1,166 @@
+/*
+ * Simulation.h -- the C API of libquadtree, for embedding the simulation
+ *
+ * A Simulation is an opaque handle on one world: its lines, its quadtrees
+ * and its counters.  Simulations share no simulation state, so a program
+ * may step different ones at once from its own threads or Cilk tasks, but
+ * must not call into one simulation from two threads at once.  A library
+ * built with MEMORY_STATS counts allocations process-wide, over every
+ * simulation, and one built with TRACING records every simulation's tasks
+ * into the same per-worker buffers; neither changes the results.
+ *
+ * Lines are read back in place.  The line storage is a few chunks, each an
+ * array of records Simulation_lineLayout().stride bytes apart, with every
+ * field at its offset in the layout; a caller reads positions straight out
+ * of the simulation without copying them and without the internal Line
+ * struct.  Slots of lines removed by Simulation_removeLine stay in the
+ * chunks with kind SIMULATION_RETIRED_LINE and must be skipped, until
+ * Simulation_insertLine reuses them.  The chunk pointers are valid until
+ * the next Simulation_step, Simulation_insertLine or Simulation_delete.
+ *
+ * This header is all an embedder needs; it includes nothing of the
+ * simulation's own and keeps its meaning across releases with the same
+ * SIMULATION_API_VERSION.
+ */
+
+#ifndef SIMULATION_H_
+#define SIMULATION_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SIMULATION_API_VERSION 1
+
+#define SIMULATION_API __attribute__((visibility("default")))
+
+// The kind field of a line.
+#define SIMULATION_DYNAMIC_LINE 0
+#define SIMULATION_STATIC_LINE 1
+#define SIMULATION_RETIRED_LINE 2
+
+typedef struct Simulation Simulation;
+
+// Parameters of a new simulation; zero fields take the defaults.
+typedef struct {
+  double timeStep;
+  unsigned int maxLinesPerNode;  // lines at which a quadtree node splits
+} SimulationParams;
+
+// Where the fields of a line are within its record.  p1, p2 and velocity
+// are each an x and a y double; id is an unsigned int and kind an int.
+// Coordinates are box units within [xMin, xMax) by [yMin, yMax), and
+// velocities box units per time step.
+typedef struct {
+  size_t stride;
+  size_t p1;
+  size_t p2;
+  size_t velocity;
+  size_t id;
+  size_t kind;
+  double xMin;
+  double xMax;
+  double yMin;
+  double yMax;
+} SimulationLineLayout;
+
+// Totals since the scene was loaded.
+typedef struct {
+  unsigned int frames;
+  unsigned int numLines;
+  unsigned int numActiveLines;  // awake during the last frame
+  unsigned int lineWallCollisions;
+  unsigned int lineLineCollisions;
+  uint64_t narrowPhaseTests;
+  uint64_t narrowPhaseSkips;
+  uint64_t boxRejects;
+  uint64_t events;
+} SimulationStats;
+
+// A line found by a query: its id, the chunk and slot of its record, and
+// its distance from the query, which is from a along the segment for
+// segment queries, from the centre for radius and nearest queries, and 0
+// for range queries.
+typedef struct {
+  unsigned int id;
+  unsigned int chunk;
+  unsigned int slot;
+  double distance;
+} SimulationMatch;
+
+// The SIMULATION_API_VERSION the library was built with.
+SIMULATION_API int Simulation_apiVersion();
+
+// Load the text or binary scene at path and build its quadtrees.  params
+// may be NULL for the defaults.  Returns NULL, after printing why, if the
+// scene can't be loaded.
+SIMULATION_API Simulation* Simulation_load(const char *path,
+                                           const SimulationParams *params);
+
+SIMULATION_API void Simulation_delete(Simulation *simulation);
+
+// Simulate numFrames more frames.
+SIMULATION_API void Simulation_step(Simulation *simulation,
+                                    unsigned int numFrames);
+
+// The layout of the records in every chunk.
+SIMULATION_API void Simulation_lineLayout(SimulationLineLayout *layout);
+
+SIMULATION_API unsigned int Simulation_numChunks(
+    const Simulation *simulation);
+
+// The records of chunk, and in *count how many slots of it are in use.
+// Returns NULL, with *count 0, if there is no such chunk.
+SIMULATION_API const void* Simulation_chunk(const Simulation *simulation,
+                                            unsigned int chunk,
+                                            unsigned int *count);
+
+// Add a moving line from p1 to p2, moving by velocity each time step, all
+// as {x, y} in box units; gray picks the gray colour over red.  Call it
+// between steps.  Returns the line's id and sets *chunk and *slot to where
+// its record is, to read it and to remove it by; or returns -1, changing
+// nothing, if an endpoint is outside the box.  Lines never move between
+// slots, so a line's chunk and slot stay its own until it is removed.
+SIMULATION_API int Simulation_insertLine(Simulation *simulation,
+                                         const double p1[2],
+                                         const double p2[2],
+                                         const double velocity[2],
+                                         bool gray, unsigned int *chunk,
+                                         unsigned int *slot);
+
+// Remove the moving line in slot of chunk, as returned by
+// Simulation_insertLine or found by reading the chunks or by a query,
+// leaving the slot retired.  Call it between steps.  Returns false if
+// there is no moving line there.
+SIMULATION_API bool Simulation_removeLine(Simulation *simulation,
+                                          unsigned int chunk,
+                                          unsigned int slot);
+
+SIMULATION_API void Simulation_getStats(const Simulation *simulation,
+                                        SimulationStats *stats);
+
+// The queries below search the quadtrees rather than every line, and run
+// between steps.  Each writes at most maxMatches matches and returns how
+// many lines matched, which may be more.  Points are {x, y} in box units.
+
+// The lines touching the rectangle with corners a and b, in id order.
+SIMULATION_API unsigned int Simulation_queryRange(
+    const Simulation *simulation, const double a[2], const double b[2],
+    SimulationMatch *matches, unsigned int maxMatches);
+
+// The lines touching the segment from a to b, nearest a first.
+SIMULATION_API unsigned int Simulation_querySegment(
+    const Simulation *simulation, const double a[2], const double b[2],
+    SimulationMatch *matches, unsigned int maxMatches);
+
+// The lines within radius of centre, in id order.
+SIMULATION_API unsigned int Simulation_queryRadius(
+    const Simulation *simulation, const double centre[2], double radius,
+    SimulationMatch *matches, unsigned int maxMatches);
+
+// The k lines nearest point, nearest first; fewer if there aren't k.
+SIMULATION_API unsigned int Simulation_queryNearest(
+    const Simulation *simulation, const double point[2], unsigned int k,
+    SimulationMatch *matches, unsigned int maxMatches);
+
+#endif  // SIMULATION_H_
@@ -0,0 +1,340 @@
+/*
+ * SpatialQuery.c -- range, segment, radius and nearest-line queries
+ */
+
+#include "./SpatialQuery.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <cilk/cilk.h>
+
+#include "./IntersectionDetection.h"
+#include "./Quadtree.h"
+
+// A query with its rectangle's corners in order.
+typedef struct {
+  const SpatialQuery *query;
+  double xMin;
+  double xMax;
+  double yMin;
+  double yMax;
+} Region;
+
+// One query's matches as they are found.  For nearest queries, a max-heap
+// of the k nearest so far.
+typedef struct {
+  SpatialMatch *matches;
+  unsigned int count;
+  unsigned int capacity;
+} Matches;
+
+static void addMatch(Matches *matches, Line *line, double distance) {
+  if (matches->count == matches->capacity) {
+    matches->capacity = matches->capacity ? 2 * matches->capacity : 16;
+    matches->matches = realloc(matches->matches,
+                               matches->capacity * sizeof(SpatialMatch));
+  }
+  matches->matches[matches->count].line = line;
+  matches->matches[matches->count].distance = distance;
+  matches->count++;
+}
+
+// The order of nearest and segment matches: by distance, then by id.
+static inline bool before(const SpatialMatch *x, const SpatialMatch *y) {
+  return x->distance < y->distance
+      || (x->distance == y->distance && x->line->id < y->line->id);
+}
+
+static void swapMatches(SpatialMatch *x, SpatialMatch *y) {
+  SpatialMatch swap = *x;
+  *x = *y;
+  *y = swap;
+}
+
+// Keeps the k nearest matches, the farthest of them on top of the heap.
+static void addNearest(Matches *matches, unsigned int k, Line *line,
+                       double distance) {
+  SpatialMatch match = {line, distance};
+  SpatialMatch *heap = matches->matches;
+  if (matches->count < k) {
+    addMatch(matches, line, distance);
+    heap = matches->matches;
+    for (unsigned int i = matches->count - 1;
+         i > 0 && before(&heap[(i - 1) / 2], &heap[i]); i = (i - 1) / 2) {
+      swapMatches(&heap[(i - 1) / 2], &heap[i]);
+    }
+    return;
+  }
+  if (!before(&match, &heap[0])) {
+    return;
+  }
+  heap[0] = match;
+  unsigned int i = 0;
+  while (true) {
+    unsigned int farthest = i;
+    for (unsigned int child = 2 * i + 1; child <= 2 * i + 2; child++) {
+      if (child < matches->count && before(&heap[farthest], &heap[child])) {
+        farthest = child;
+      }
+    }
+    if (farthest == i) {
+      break;
+    }
+    swapMatches(&heap[i], &heap[farthest]);
+    i = farthest;
+  }
+}
+
+// Whether any of the segment (p, q) lies in the closed rectangle, by
+// clipping the segment to it (Liang-Barsky).
+static bool segmentTouchesBox(Vec p, Vec q, double xMin, double xMax,
+                              double yMin, double yMax) {
+  const double dx = q.x - p.x;
+  const double dy = q.y - p.y;
+  const double directions[4] = {-dx, dx, -dy, dy};
+  const double room[4] = {p.x - xMin, xMax - p.x, p.y - yMin, yMax - p.y};
+  double t0 = 0;
+  double t1 = 1;
+  for (int i = 0; i < 4; i++) {
+    if (directions[i] == 0) {
+      if (room[i] < 0) {
+        return false;
+      }
+      continue;
+    }
+    const double t = room[i] / directions[i];
+    if (directions[i] < 0) {
+      if (t > t1) {
+        return false;
+      }
+      t0 = fmax(t0, t);
+    } else {
+      if (t < t0) {
+        return false;
+      }
+      t1 = fmin(t1, t);
+    }
+  }
+  return true;
+}
+
+static double boxDistance(Vec p, double xMin, double xMax, double yMin,
+                          double yMax) {
+  const double dx = fmax(fmax(xMin - p.x, p.x - xMax), 0);
+  const double dy = fmax(fmax(yMin - p.y, p.y - yMax), 0);
+  return sqrt(dx * dx + dy * dy);
+}
+
+// Distance from a along (a, b) to where line first touches the segment,
+// which it must.
+static double castDistance(Vec a, Vec b, const Line *line) {
+  const Vec d = Vec_subtract(b, a);
+  const Vec e = Vec_subtract(line->p2, line->p1);
+  const double length = Vec_length(d);
+  if (length == 0) {
+    return 0;
+  }
+  const double denominator = Vec_crossProduct(d, e);
+  double t;
+  if (denominator != 0) {
+    t = Vec_crossProduct(Vec_subtract(line->p1, a), e) / denominator;
+  } else {
+    // parallel, so the line overlaps the segment; take its nearer end
+    t = fmin(Vec_dotProduct(Vec_subtract(line->p1, a), d),
+             Vec_dotProduct(Vec_subtract(line->p2, a), d))
+        / (length * length);
+  }
+  return fmin(fmax(t, 0), 1) * length;
+}
+
+static void testLine(const Region *region, Line *line, Matches *matches) {
+  const SpatialQuery *query = region->query;
+  switch (query->kind) {
+    case QUERY_RANGE:
+      if (segmentTouchesBox(line->p1, line->p2, region->xMin, region->xMax,
+                            region->yMin, region->yMax)) {
+        addMatch(matches, line, 0);
+      }
+      break;
+    case QUERY_SEGMENT:
+      if (segmentDistance(query->a, query->b, line->p1, line->p2) == 0) {
+        addMatch(matches, line, castDistance(query->a, query->b, line));
+      }
+      break;
+    case QUERY_RADIUS: {
+      const double distance = segmentDistance(query->a, query->a, line->p1,
+                                              line->p2);
+      if (distance <= query->radius) {
+        addMatch(matches, line, distance);
+      }
+      break;
+    }
+    case QUERY_NEAREST:
+      addNearest(matches, query->k, line,
+                 segmentDistance(query->a, query->a, line->p1, line->p2));
+      break;
+  }
+}
+
+// Whether the lines under node may match.
+static bool reaches(const Region *region, const Node *node,
+                    const Matches *matches) {
+  const SpatialQuery *query = region->query;
+  switch (query->kind) {
+    case QUERY_RANGE:
+      return node->xMin <= region->xMax && node->xMax >= region->xMin
+          && node->yMin <= region->yMax && node->yMax >= region->yMin;
+    case QUERY_SEGMENT:
+      return segmentTouchesBox(query->a, query->b, node->xMin, node->xMax,
+                               node->yMin, node->yMax);
+    case QUERY_RADIUS:
+      return boxDistance(query->a, node->xMin, node->xMax, node->yMin,
+                         node->yMax) <= query->radius;
+    case QUERY_NEAREST:
+      return matches->count < query->k
+          || boxDistance(query->a, node->xMin, node->xMax, node->yMin,
+                         node->yMax) <= matches->matches[0].distance;
+  }
+  return true;
+}
+
+static void queryNode(const Region *region, Node *node, Matches *matches) {
+  LineNode *lineNode = node->lines;
+  for (int i = 0; i < node->numberOfLines; i++) {
+    testLine(region, lineNode->line, matches);
+    lineNode = lineNode->next;
+  }
+  if (node->nw == NULL) {
+    return;
+  }
+
+  Node *children[4] = {node->nw, node->ne, node->sw, node->se};
+  if (region->query->kind == QUERY_NEAREST) {
+    // nearest child first, so the heap fills with close lines early
+    double distances[4];
+    for (int i = 0; i < 4; i++) {
+      distances[i] = boxDistance(region->query->a, children[i]->xMin,
+                                 children[i]->xMax, children[i]->yMin,
+                                 children[i]->yMax);
+      for (int j = i; j > 0 && distances[j] < distances[j - 1]; j--) {
+        double distance = distances[j];
+        distances[j] = distances[j - 1];
+        distances[j - 1] = distance;
+        Node *child = children[j];
+        children[j] = children[j - 1];
+        children[j - 1] = child;
+      }
+    }
+  }
+  for (int i = 0; i < 4; i++) {
+    if (reaches(region, children[i], matches)) {
+      queryNode(region, children[i], matches);
+    }
+  }
+}
+
+static int compareById(const void *x, const void *y) {
+  const unsigned int id1 = ((const SpatialMatch *) x)->line->id;
+  const unsigned int id2 = ((const SpatialMatch *) y)->line->id;
+  return (id1 > id2) - (id1 < id2);
+}
+
+static int compareByDistance(const void *x, const void *y) {
+  return before(x, y) ? -1 : before(y, x) ? 1 : 0;
+}
+
+static void runQuery(CollisionWorld *collisionWorld, const SpatialQuery *query,
+                     bool bruteForce, Matches *matches) {
+  Region region = {query, fmin(query->a.x, query->b.x),
+                   fmax(query->a.x, query->b.x), fmin(query->a.y, query->b.y),
+                   fmax(query->a.y, query->b.y)};
+  matches->matches = NULL;
+  matches->count = 0;
+  matches->capacity = 0;
+  if (query->kind == QUERY_NEAREST && query->k == 0) {
+    return;
+  }
+
+  if (bruteForce) {
+    for (unsigned int i = 0; i < collisionWorld->numOfLines; i++) {
+      testLine(&region, collisionWorld->lines[i], matches);
+    }
+  } else {
+    if (collisionWorld->quadtree != NULL) {
+      queryNode(&region, collisionWorld->quadtree, matches);
+    }
+    if (collisionWorld->staticQuadtree != NULL) {
+      queryNode(&region, collisionWorld->staticQuadtree, matches);
+    }
+  }
+
+  qsort(matches->matches, matches->count, sizeof(SpatialMatch),
+        query->kind == QUERY_RANGE || query->kind == QUERY_RADIUS
+        ? compareById : compareByDistance);
+}
+
+static void runBatch(CollisionWorld *collisionWorld,
+                     const SpatialQuery *queries, unsigned int numQueries,
+                     bool bruteForce, SpatialQueryResults *results) {
+  Matches *matches = malloc(numQueries * sizeof(Matches));
+  cilk_for (unsigned int i = 0; i < numQueries; i++) {
+    runQuery(collisionWorld, &queries[i], bruteForce, &matches[i]);
+  }
+
+  results->numQueries = numQueries;
+  results->first = malloc((numQueries + 1) * sizeof(unsigned int));
+  unsigned int numMatches = 0;
+  for (unsigned int i = 0; i < numQueries; i++) {
+    results->first[i] = numMatches;
+    numMatches += matches[i].count;
+  }
+  results->first[numQueries] = numMatches;
+  results->matches = malloc(numMatches * sizeof(SpatialMatch));
+  cilk_for (unsigned int i = 0; i < numQueries; i++) {
+    for (unsigned int j = 0; j < matches[i].count; j++) {
+      results->matches[results->first[i] + j] = matches[i].matches[j];
+    }
+    free(matches[i].matches);
+  }
+  free(matches);
+}
+
+void SpatialQuery_batch(CollisionWorld *collisionWorld,
+                        const SpatialQuery *queries, unsigned int numQueries,
+                        SpatialQueryResults *results) {
+  runBatch(collisionWorld, queries, numQueries, false, results);
+}
+
+void SpatialQuery_bruteForce(CollisionWorld *collisionWorld,
+                             const SpatialQuery *queries,
+                             unsigned int numQueries,
+                             SpatialQueryResults *results) {
+  runBatch(collisionWorld, queries, numQueries, true, results);
+}
+
+bool SpatialQueryResults_equal(const SpatialQueryResults *results1,
+                               const SpatialQueryResults *results2) {
+  if (results1->numQueries != results2->numQueries) {
+    return false;
+  }
+  for (unsigned int i = 0; i <= results1->numQueries; i++) {
+    if (results1->first[i] != results2->first[i]) {
+      return false;
+    }
+  }
+  for (unsigned int i = 0; i < results1->first[results1->numQueries]; i++) {
+    if (results1->matches[i].line != results2->matches[i].line
+        || results1->matches[i].distance != results2->matches[i].distance) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void SpatialQueryResults_free(SpatialQueryResults *results) {
+  free(results->matches);
+  free(results->first);
+  results->matches = NULL;
+  results->first = NULL;
+  results->numQueries = 0;
+}
@@ -0,0 +1,79 @@
+/*
+ * SpatialQuery.h -- range, segment, radius and nearest-line queries
+ *
+ * Answers "which lines touch this rectangle, this segment or this disc,
+ * and which k lines are nearest this point" from a CollisionWorld's
+ * quadtree and static index, rather than by scanning every line.  A line
+ * held by a node lies within the node's bounds, so a query descends only
+ * into the children its region reaches; the root's own lines are always
+ * tested, since lines poking out of the box stay there.
+ *
+ * SpatialQuery_batch answers many queries in parallel.  It only reads the
+ * quadtrees, so it must run between frames, never during
+ * CollisionWorld_updateLines; every query then sees the same positions.
+ * SpatialQuery_bruteForce answers the same batch by testing every line, to
+ * check and time the quadtree against.
+ */
+
+#ifndef SPATIALQUERY_H_
+#define SPATIALQUERY_H_
+
+#include <stdbool.h>
+
+#include "./CollisionWorld.h"
+#include "./Line.h"
+#include "./Vec.h"
+
+typedef enum {
+  QUERY_RANGE,    // lines touching the rectangle from a to b
+  QUERY_SEGMENT,  // lines touching the segment (a, b), nearest a first
+  QUERY_RADIUS,   // lines within radius of a
+  QUERY_NEAREST   // the k lines nearest a, nearest first
+} SpatialQueryKind;
+
+// One query, in box coordinates.  A range query's corners may be given in
+// any order.
+typedef struct {
+  SpatialQueryKind kind;
+  Vec a;
+  Vec b;
+  double radius;
+  unsigned int k;
+} SpatialQuery;
+
+// A line found by a query and its distance from the query: from a along
+// the segment for segment queries, from a for radius and nearest queries,
+// and 0 for range queries.
+typedef struct {
+  Line *line;
+  double distance;
+} SpatialMatch;
+
+// The matches of a batch, query after query.  Query i matched
+// matches[first[i]] up to matches[first[i + 1]].  Range and radius matches
+// are in line id order, segment and nearest ones by distance, then id.
+typedef struct {
+  SpatialMatch *matches;
+  unsigned int *first;
+  unsigned int numQueries;
+} SpatialQueryResults;
+
+// Answer queries[0 ... numQueries - 1] against collisionWorld's quadtree
+// and static index, in parallel, into results.
+void SpatialQuery_batch(CollisionWorld *collisionWorld,
+                        const SpatialQuery *queries, unsigned int numQueries,
+                        SpatialQueryResults *results);
+
+// The same, by testing every line of collisionWorld.
+void SpatialQuery_bruteForce(CollisionWorld *collisionWorld,
+                             const SpatialQuery *queries,
+                             unsigned int numQueries,
+                             SpatialQueryResults *results);
+
+// Whether two batches hold the same matches.
+bool SpatialQueryResults_equal(const SpatialQueryResults *results1,
+                               const SpatialQueryResults *results2);
+
+void SpatialQueryResults_free(SpatialQueryResults *results);
+
+#endif  // SPATIALQUERY_H_
@@ -0,0 +1,148 @@
+/*
+ * Tracer.c -- Chrome trace-event export of parallel task execution
+ */
+
+#include "./Tracer.h"
+
+#ifdef TRACING
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cilk/cilk_api.h>
+
+typedef struct {
+  const char *name;
+  const char *argName;
+  fasttime_t start;
+  fasttime_t end;
+  unsigned int arg;
+  int beginWorker;
+} TraceEvent;
+
+// One worker's events, written only by that worker.  Padded so that
+// neighbouring workers' counters don't share a cache line.
+typedef struct {
+  TraceEvent *events;
+  unsigned int numEvents;
+  unsigned int capacity;
+  unsigned long long dropped;
+  char padding[64];
+} TraceBuffer;
+
+bool tracing = false;
+
+static char *tracePath;
+static FILE *traceFile;
+static fasttime_t traceStart;
+static TraceBuffer *buffers;
+static int numWorkers;
+// Events recorded outside the Cilk workers, which are not traced.
+static unsigned long long foreignEvents;
+
+bool Tracer_start(const char *path) {
+  traceFile = fopen(path, "w");
+  if (traceFile == NULL) {
+    perror(path);
+    return false;
+  }
+  tracePath = strdup(path);
+  numWorkers = __cilkrts_get_nworkers();
+  buffers = calloc(numWorkers, sizeof(TraceBuffer));
+  traceStart = gettime();
+  tracing = true;
+  return true;
+}
+
+int Tracer_worker() {
+  return __cilkrts_get_worker_number();
+}
+
+void Tracer_record(const char *name, fasttime_t start, int beginWorker,
+                   const char *argName, unsigned int arg) {
+  const fasttime_t end = gettime();
+  const int worker = Tracer_worker();
+  if (worker < 0 || worker >= numWorkers) {
+    __sync_fetch_and_add(&foreignEvents, 1);
+    return;
+  }
+  TraceBuffer *buffer = &buffers[worker];
+  if (buffer->numEvents == buffer->capacity) {
+    if (buffer->capacity == TRACER_MAX_EVENTS_PER_WORKER) {
+      buffer->dropped++;
+      return;
+    }
+    buffer->capacity = buffer->capacity ? 2 * buffer->capacity : 4096;
+    buffer->events = realloc(buffer->events,
+                             buffer->capacity * sizeof(TraceEvent));
+  }
+  TraceEvent *event = &buffer->events[buffer->numEvents++];
+  event->name = name;
+  event->argName = argName;
+  event->start = start;
+  event->end = end;
+  event->arg = arg;
+  event->beginWorker = beginWorker;
+}
+
+bool Tracer_finish() {
+  if (!tracing) {
+    return true;
+  }
+  tracing = false;
+
+  unsigned long long numEvents = 0, dropped = 0;
+  fprintf(traceFile, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+  fprintf(traceFile, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,"
+          "\"args\":{\"name\":\"Screensaver\"}}");
+  for (int worker = 0; worker < numWorkers; worker++) {
+    fprintf(traceFile, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+            "\"tid\":%d,\"args\":{\"name\":\"worker %d\"}}", worker, worker);
+  }
+  for (int worker = 0; worker < numWorkers; worker++) {
+    TraceBuffer *buffer = &buffers[worker];
+    for (unsigned int i = 0; i < buffer->numEvents; i++) {
+      TraceEvent *event = &buffer->events[i];
+      // a frame that resumed on another worker after a sync stays on the
+      // track it started on
+      fprintf(traceFile, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,"
+              "\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"%s\":%u",
+              event->name, event->beginWorker,
+              1e6 * tdiff(traceStart, event->start),
+              1e6 * tdiff(event->start, event->end), event->argName,
+              event->arg);
+      if (event->beginWorker != worker) {
+        fprintf(traceFile, ",\"resumedOn\":%d", worker);
+      }
+      fprintf(traceFile, "}}");
+    }
+    numEvents += buffer->numEvents;
+    dropped += buffer->dropped;
+    free(buffer->events);
+  }
+  fprintf(traceFile, "\n]}\n");
+
+  bool ok = !ferror(traceFile);
+  if (fclose(traceFile) != 0) {
+    ok = false;
+  }
+  if (!ok) {
+    perror(tracePath);
+  }
+  printf("Trace: %llu events from %d workers written to %s", numEvents,
+         numWorkers, tracePath);
+  if (dropped + foreignEvents != 0) {
+    printf(" (%llu dropped, %llu from non-worker threads)", dropped,
+           foreignEvents);
+  }
+  printf("\n");
+
+  free(buffers);
+  free(tracePath);
+  buffers = NULL;
+  tracePath = NULL;
+  traceFile = NULL;
+  return ok;
+}
+
+#endif  // TRACING
@@ -0,0 +1,66 @@
+/*
+ * Tracer.h -- Chrome trace-event export of parallel task execution
+ *
+ * Built only when TRACING is defined ("make TRACING=1"), and then only
+ * records while started.  Instrumented code brackets a task with
+ * TRACE_BEGIN and TRACE_END; the task's start and end times, the Cilk
+ * worker that started it and the one that finished it, and one integer
+ * argument go into the finishing worker's own buffer, so recording takes
+ * no locks.  Tracer_finish writes every buffer as Chrome trace-event JSON,
+ * one track per worker, which Perfetto (ui.perfetto.dev) and
+ * chrome://tracing can open.
+ *
+ * Without TRACING the macros expand to nothing.  With it but not started,
+ * each macro costs one predictable branch.
+ */
+
+#ifndef TRACER_H_
+#define TRACER_H_
+
+#include <stdbool.h>
+
+#ifdef TRACING
+
+#include "./fasttime.h"
+
+// Events each worker can hold; later ones are dropped and counted.
+#define TRACER_MAX_EVENTS_PER_WORKER (1 << 22)
+
+// Whether the tracer is recording.
+extern bool tracing;
+
+// Start recording, to be written to path by Tracer_finish.  Returns false,
+// after printing why, if path can't be created.
+bool Tracer_start(const char *path);
+
+// Record a task that started at start on beginWorker and ends now.
+// name and argName must be string literals.
+void Tracer_record(const char *name, fasttime_t start, int beginWorker,
+                   const char *argName, unsigned int arg);
+
+// The Cilk worker running the caller.
+int Tracer_worker();
+
+// Stop recording, write the trace, and free the buffers.  Returns false if
+// writing failed.  Does nothing if the tracer wasn't started.
+bool Tracer_finish();
+
+#define TRACE_BEGIN(task) \
+  const fasttime_t task##TraceStart = tracing ? gettime() : (fasttime_t) {0}; \
+  const int task##TraceWorker = tracing ? Tracer_worker() : 0
+
+#define TRACE_END(task, name, argName, arg) \
+  do { \
+    if (tracing) { \
+      Tracer_record(name, task##TraceStart, task##TraceWorker, argName, arg); \
+    } \
+  } while (0)
+
+#else
+
+#define TRACE_BEGIN(task)
+#define TRACE_END(task, name, argName, arg)
+
+#endif  // TRACING
+
+#endif  // TRACER_H_
@@ -0,0 +1,257 @@
+/*
+ * Trajectory.c -- asynchronous compressed trajectory writer
+ */
+
+#include "./Trajectory.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "./fasttime.h"
+
+static const char TRAJECTORY_MAGIC[8] = {'L', 'I', 'N', 'E', 'T', 'R', 'J', '\0'};
+
+struct Trajectory {
+  FILE *fout;
+  char *path;
+  CollisionWorld *collisionWorld;  // its line set is pinned while open
+  unsigned int numOfLines;
+  size_t numOfValues;
+
+  // Ring of raw frames; slots [head, head + count) are queued.
+  double *frames;
+  unsigned int frameNumbers[TRAJECTORY_QUEUE_FRAMES];
+  unsigned int head;
+  unsigned int count;
+  bool closing;
+  pthread_mutex_t lock;
+  pthread_cond_t notEmpty;
+  pthread_cond_t notFull;
+  pthread_t writer;
+
+  // Owned by the writer thread.
+  uint64_t *previous;
+  uint64_t *step;
+  unsigned char *payload;
+  bool failed;
+  uint64_t rawBytes;
+  uint64_t writtenBytes;
+
+  // Owned by the thread queueing frames.
+  unsigned int numFrames;
+  double copySeconds;
+  double blockedSeconds;
+};
+
+static inline int significantBytes(uint64_t word) {
+  return word == 0 ? 0 : 8 - __builtin_clzll(word) / 8;
+}
+
+// Encodes frame against the prediction from the two previous frames, and
+// advances them.  Returns the number of payload bytes.
+static size_t encodeFrame(Trajectory *trajectory, const double *frame) {
+  uint64_t *previous = trajectory->previous;
+  uint64_t *step = trajectory->step;
+  unsigned char *out = trajectory->payload;
+  const size_t numOfValues = trajectory->numOfValues;
+
+  for (size_t i = 0; i < numOfValues; i += 2) {
+    uint64_t words[2] = {0, 0};
+    int sizes[2] = {0, 0};
+    for (int j = 0; j < 2 && i + j < numOfValues; j++) {
+      uint64_t bits;
+      memcpy(&bits, &frame[i + j], sizeof(bits));
+      words[j] = bits ^ (previous[i + j] + step[i + j]);
+      sizes[j] = significantBytes(words[j]);
+      step[i + j] = bits - previous[i + j];
+      previous[i + j] = bits;
+    }
+    *out++ = sizes[0] | (sizes[1] << 4);
+    for (int j = 0; j < 2; j++) {
+      for (int b = 0; b < sizes[j]; b++) {
+        *out++ = words[j] >> (8 * b);
+      }
+    }
+  }
+  return out - trajectory->payload;
+}
+
+static void * writerMain(void *arg) {
+  Trajectory *trajectory = arg;
+  const size_t frameValues = trajectory->numOfValues;
+
+  pthread_mutex_lock(&trajectory->lock);
+  while (true) {
+    while (trajectory->count == 0 && !trajectory->closing) {
+      pthread_cond_wait(&trajectory->notEmpty, &trajectory->lock);
+    }
+    if (trajectory->count == 0) {
+      break;
+    }
+    const unsigned int slot = trajectory->head;
+    const uint32_t frameNumber = trajectory->frameNumbers[slot];
+    pthread_mutex_unlock(&trajectory->lock);
+
+    // the slot stays queued, so the simulation can't overwrite it yet
+    size_t size = encodeFrame(trajectory,
+                              &trajectory->frames[slot * frameValues]);
+    uint32_t record[2] = {frameNumber, size};
+    if (!trajectory->failed
+        && (fwrite(record, sizeof(record), 1, trajectory->fout) != 1
+            || fwrite(trajectory->payload, 1, size, trajectory->fout) != size)) {
+      perror(trajectory->path);
+      trajectory->failed = true;
+    }
+    trajectory->rawBytes += frameValues * sizeof(double);
+    trajectory->writtenBytes += sizeof(record) + size;
+
+    pthread_mutex_lock(&trajectory->lock);
+    trajectory->head = (trajectory->head + 1) % TRAJECTORY_QUEUE_FRAMES;
+    trajectory->count--;
+    pthread_cond_signal(&trajectory->notFull);
+  }
+  pthread_mutex_unlock(&trajectory->lock);
+  return NULL;
+}
+
+Trajectory* Trajectory_open(const char *path,
+                            CollisionWorld *collisionWorld) {
+  const unsigned int numOfLines = collisionWorld->numOfLines;
+  FILE *fout = fopen(path, "wb");
+  if (fout == NULL) {
+    perror(path);
+    return NULL;
+  }
+  TrajectoryHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, TRAJECTORY_MAGIC, sizeof(TRAJECTORY_MAGIC));
+  header.version = TRAJECTORY_VERSION;
+  header.numOfLines = numOfLines;
+  header.valuesPerLine = TRAJECTORY_VALUES_PER_LINE;
+  if (fwrite(&header, sizeof(header), 1, fout) != 1) {
+    perror(path);
+    fclose(fout);
+    return NULL;
+  }
+
+  Trajectory *trajectory = calloc(1, sizeof(Trajectory));
+  trajectory->fout = fout;
+  trajectory->path = strdup(path);
+  trajectory->collisionWorld = collisionWorld;
+  trajectory->numOfLines = numOfLines;
+  trajectory->numOfValues = (size_t) numOfLines * TRAJECTORY_VALUES_PER_LINE;
+  trajectory->frames = malloc(TRAJECTORY_QUEUE_FRAMES
+                              * trajectory->numOfValues * sizeof(double));
+  trajectory->previous = calloc(trajectory->numOfValues, sizeof(uint64_t));
+  trajectory->step = calloc(trajectory->numOfValues, sizeof(uint64_t));
+  // worst case: every value needs 8 bytes, plus a header byte per pair
+  trajectory->payload = malloc(trajectory->numOfValues * 8
+                               + (trajectory->numOfValues + 1) / 2);
+  pthread_mutex_init(&trajectory->lock, NULL);
+  pthread_cond_init(&trajectory->notEmpty, NULL);
+  pthread_cond_init(&trajectory->notFull, NULL);
+  if (pthread_create(&trajectory->writer, NULL, writerMain, trajectory) != 0) {
+    perror("pthread_create");
+    fclose(fout);
+    free(trajectory->frames);
+    free(trajectory->previous);
+    free(trajectory->step);
+    free(trajectory->payload);
+    free(trajectory->path);
+    free(trajectory);
+    return NULL;
+  }
+  collisionWorld->lineSetPins++;
+  return trajectory;
+}
+
+// Queue the positions of lines[0 ... numOfLines - 1], or of the published
+// lines if lines is NULL, as frame.
+static void queueFrame(Trajectory *trajectory, unsigned int frame,
+                       Line *const *lines, const PublishedLine *published) {
+  const fasttime_t startTime = gettime();
+  pthread_mutex_lock(&trajectory->lock);
+  while (trajectory->count == TRAJECTORY_QUEUE_FRAMES) {
+    pthread_cond_wait(&trajectory->notFull, &trajectory->lock);
+  }
+  const unsigned int slot =
+      (trajectory->head + trajectory->count) % TRAJECTORY_QUEUE_FRAMES;
+  pthread_mutex_unlock(&trajectory->lock);
+  const fasttime_t copyTime = gettime();
+
+  // only one thread fills free slots, so the copy needs no lock
+  double *values = &trajectory->frames[slot * trajectory->numOfValues];
+  for (unsigned int i = 0; i < trajectory->numOfLines; i++) {
+    const Vec p1 = lines != NULL ? lines[i]->p1 : published[i].p1;
+    const Vec p2 = lines != NULL ? lines[i]->p2 : published[i].p2;
+    values[0] = p1.x;
+    values[1] = p1.y;
+    values[2] = p2.x;
+    values[3] = p2.y;
+    values += TRAJECTORY_VALUES_PER_LINE;
+  }
+
+  pthread_mutex_lock(&trajectory->lock);
+  trajectory->frameNumbers[slot] = frame;
+  trajectory->count++;
+  pthread_cond_signal(&trajectory->notEmpty);
+  pthread_mutex_unlock(&trajectory->lock);
+
+  const fasttime_t endTime = gettime();
+  trajectory->numFrames++;
+  trajectory->blockedSeconds += tdiff(startTime, copyTime);
+  trajectory->copySeconds += tdiff(copyTime, endTime);
+}
+
+void Trajectory_writeFrame(Trajectory *trajectory, unsigned int frame) {
+  // the pin keeps lines[] the same lines
+  assert(trajectory->collisionWorld->numOfLines == trajectory->numOfLines);
+  queueFrame(trajectory, frame, trajectory->collisionWorld->lines, NULL);
+}
+
+bool Trajectory_writePublishedFrame(Trajectory *trajectory,
+                                    const PublishedFrame *frame) {
+  if (frame->numOfLines != trajectory->numOfLines) {
+    return false;
+  }
+  queueFrame(trajectory, frame->frame, NULL, frame->lines);
+  return true;
+}
+
+bool Trajectory_close(Trajectory *trajectory) {
+  pthread_mutex_lock(&trajectory->lock);
+  trajectory->closing = true;
+  pthread_cond_signal(&trajectory->notEmpty);
+  pthread_mutex_unlock(&trajectory->lock);
+  pthread_join(trajectory->writer, NULL);
+  trajectory->collisionWorld->lineSetPins--;
+
+  bool ok = !trajectory->failed;
+  if (fclose(trajectory->fout) != 0) {
+    perror(trajectory->path);
+    ok = false;
+  }
+
+  const unsigned int numFrames = trajectory->numFrames;
+  printf("Trajectory: %u frames, %llu bytes (%.1f%% of raw), "
+         "%.2fus/frame copying, %.2fus/frame blocked on the writer\n",
+         numFrames, (unsigned long long) trajectory->writtenBytes,
+         trajectory->rawBytes
+             ? 100.0 * trajectory->writtenBytes / trajectory->rawBytes : 0.0,
+         numFrames ? 1e6 * trajectory->copySeconds / numFrames : 0.0,
+         numFrames ? 1e6 * trajectory->blockedSeconds / numFrames : 0.0);
+
+  pthread_mutex_destroy(&trajectory->lock);
+  pthread_cond_destroy(&trajectory->notEmpty);
+  pthread_cond_destroy(&trajectory->notFull);
+  free(trajectory->frames);
+  free(trajectory->previous);
+  free(trajectory->step);
+  free(trajectory->payload);
+  free(trajectory->path);
+  free(trajectory);
+  return ok;
+}
@@ -0,0 +1,69 @@
+/*
+ * Trajectory.h -- asynchronous compressed trajectory writer
+ *
+ * Records the endpoints of every line after each frame.  The thread
+ * queueing frames, the simulation or a reader of its published frames,
+ * only copies positions into a bounded ring of frame buffers; a writer
+ * thread compresses and writes them, and the queueing thread blocks when
+ * the ring is full instead of buffering without limit.
+ *
+ * File layout: a TrajectoryHeader, then one record per frame:
+ *   uint32_t frame, uint32_t payloadBytes, payload.
+ * The payload covers the values p1.x, p1.y, p2.x, p2.y of every line, in
+ * line order.  Each value's bits, read as a uint64_t, are predicted as
+ * previous + (previous - beforePrevious) from the two previous frames
+ * (missing frames count as zero), so lines moving at constant velocity
+ * cost nothing.  The bits are XORed with the prediction and each result is
+ * stored as its number of significant bytes (0 to 8) in a 4-bit header,
+ * followed by those bytes, least significant first.  Headers come in
+ * pairs, low nibble first, one byte ahead of the bytes of the two values.
+ */
+
+#ifndef TRAJECTORY_H_
+#define TRAJECTORY_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "./CollisionWorld.h"
+#include "./PublishedFrames.h"
+
+#define TRAJECTORY_VERSION 1
+#define TRAJECTORY_VALUES_PER_LINE 4
+// Frames the simulation may run ahead of the writer.
+#define TRAJECTORY_QUEUE_FRAMES 8
+
+typedef struct {
+  char magic[8];  // "LINETRJ\0"
+  uint32_t version;
+  uint32_t numOfLines;
+  uint32_t valuesPerLine;
+  uint32_t reserved;
+} TrajectoryHeader;
+
+typedef struct Trajectory Trajectory;
+
+// Create path for collisionWorld's lines and start its writer thread.
+// Until the trajectory is closed, the world's line set is pinned, so lines
+// can't be inserted or removed.  Returns NULL, after printing why, if the
+// file can't be created.
+Trajectory* Trajectory_open(const char *path, CollisionWorld *collisionWorld);
+
+// Queue the current line positions of the trajectory's world as frame.
+// Blocks while the writer is TRAJECTORY_QUEUE_FRAMES frames behind.
+void Trajectory_writeFrame(Trajectory *trajectory, unsigned int frame);
+
+// The same for a frame published by the trajectory's world, queued under
+// its own frame number, so a reader thread can record frames while the
+// simulation computes the next.  Returns false, queueing nothing, if the
+// frame doesn't hold the trajectory's lines, as one published before the
+// trajectory was opened may not.
+bool Trajectory_writePublishedFrame(Trajectory *trajectory,
+                                    const PublishedFrame *frame);
+
+// Drain the queue, close the file, unpin the world's lines, print a
+// summary of the overhead and compression, and free the writer.  Returns
+// false if any write failed.
+bool Trajectory_close(Trajectory *trajectory);
+
+#endif  // TRAJECTORY_H_
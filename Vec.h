@@ -26,8 +26,6 @@
 
 #include <stdbool.h>
 
-#define globalTimeStep 0.5
-
 typedef double vec_dimension;
 
 // Forward definition of Line to avoid needing to circularly include Line.h
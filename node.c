@@ -6,6 +6,7 @@
  */
 
 #include "Quadtree.h"
+#include "MemoryStats.h"
 #include <stdlib.h>
 #include <math.h>
 #include <assert.h>
@@ -15,6 +16,7 @@ Node * create_node(double x_min, double x_max, double y_min, double y_max){
 
 	Node *node;
 	node = malloc(sizeof(Node));
+	MEMORY_ALLOC(MEMORY_NODE, sizeof(Node));
 
 	node->nw = NULL;
 	node->ne = NULL;
@@ -34,6 +36,14 @@ Node * create_node(double x_min, double x_max, double y_min, double y_max){
 	node->bufferEnd = NULL;
 	node->lines = NULL;
 
+#ifdef HEAT_MAP
+	node->pairTests = 0;
+	node->narrowPhaseTests = 0;
+	node->lineFrames = 0;
+	node->frames = 0;
+	node->seconds = 0;
+#endif
+
 	return node;
 }
 
@@ -41,18 +51,27 @@ void addLine(Node* node, Line * line) {
 	// node->enclosedLines[node->numberOfLines] = line;
 	node->numberOfLines++;
 	node->lines = createLineNode(node->lines, line);
+	line->quadtreeNode = node;
+	line->quadtreeLineNode = node->lines;
 	if (node->numberOfLines == 1) {
 		node->firstQuadtreeLineNode = node->lines;
 	}
 }
 
 void reAddQuadtreeLineNode(Node * node, LineNode * lineNode) {
+	lineNode->line->quadtreeNode = node;
+	lineNode->line->quadtreeLineNode = lineNode;
 	lineNode->next = node->lines;
 	node->lines = lineNode;
 	node->numberOfLines++;
 }
 
 void addToBuffer(Node * node, LineNode * lineNode) {
+	// the line moved to a new node; it is re-certified next frame
+	lineNode->line->nodeCertificate = 0;
+	// attachBuffers moves the buffer into this node's list
+	lineNode->line->quadtreeNode = node;
+	lineNode->line->quadtreeLineNode = lineNode;
 	if (node->buffer == NULL) {
 		node->bufferEnd = lineNode;
 	}
@@ -62,6 +81,8 @@ void addToBuffer(Node * node, LineNode * lineNode) {
 }
 
 void addQuadtreeLineNode(Node * node, LineNode * lineNode) {
+	lineNode->line->quadtreeNode = node;
+	lineNode->line->quadtreeLineNode = lineNode;
 	lineNode->next = node->lines;
 	node->lines = lineNode;
 	node->numberOfLines++;
@@ -74,6 +95,7 @@ void freeQuadtreeLineNode(LineNode * lineNode) {
 	if (lineNode != NULL) {
 		freeQuadtreeLineNode(lineNode->next);
 		free(lineNode);
+		MEMORY_FREE(MEMORY_LINE_NODE, sizeof(LineNode));
 	}
 }
 
@@ -86,5 +108,6 @@ void freeNode(Node * node){
 		// free(node->enclosedLines);
 		freeQuadtreeLineNode(node->lines);
 		free(node);
+		MEMORY_FREE(MEMORY_NODE, sizeof(Node));
 	}
 }